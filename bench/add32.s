@@ -0,0 +1,150 @@
+; Multi-byte addition: 32-bit Fibonacci numbers with carries detected from sign bits, wrapping around
+start:   LD one
+         ST y0
+         LD zero
+         ST y1
+         ST y2
+         ST y3
+         ST x0
+         ST x1
+         ST x2
+         ST x3
+loop:    LD zero
+         ST incoming
+         LD zero
+         ST carry
+         LD x0
+         ADD y0
+         ST z0
+         LD x0
+         JMN xneg0
+         LD y0
+         JMN mixed0
+         JMP addc0
+xneg0:   LD y0
+         JMN setc0
+mixed0:  LD z0
+         JMN addc0
+setc0:   LD one
+         ST carry
+addc0:   LD z0
+         ADD incoming
+         ST z0
+         JMZ wrap0
+         JMP next0
+wrap0:   LD incoming
+         JMZ next0
+         ST carry
+next0:   LD carry
+         ST incoming
+         LD zero
+         ST carry
+         LD x1
+         ADD y1
+         ST z1
+         LD x1
+         JMN xneg1
+         LD y1
+         JMN mixed1
+         JMP addc1
+xneg1:   LD y1
+         JMN setc1
+mixed1:  LD z1
+         JMN addc1
+setc1:   LD one
+         ST carry
+addc1:   LD z1
+         ADD incoming
+         ST z1
+         JMZ wrap1
+         JMP next1
+wrap1:   LD incoming
+         JMZ next1
+         ST carry
+next1:   LD carry
+         ST incoming
+         LD zero
+         ST carry
+         LD x2
+         ADD y2
+         ST z2
+         LD x2
+         JMN xneg2
+         LD y2
+         JMN mixed2
+         JMP addc2
+xneg2:   LD y2
+         JMN setc2
+mixed2:  LD z2
+         JMN addc2
+setc2:   LD one
+         ST carry
+addc2:   LD z2
+         ADD incoming
+         ST z2
+         JMZ wrap2
+         JMP next2
+wrap2:   LD incoming
+         JMZ next2
+         ST carry
+next2:   LD carry
+         ST incoming
+         LD zero
+         ST carry
+         LD x3
+         ADD y3
+         ST z3
+         LD x3
+         JMN xneg3
+         LD y3
+         JMN mixed3
+         JMP addc3
+xneg3:   LD y3
+         JMN setc3
+mixed3:  LD z3
+         JMN addc3
+setc3:   LD one
+         ST carry
+addc3:   LD z3
+         ADD incoming
+         ST z3
+         JMZ wrap3
+         JMP next3
+wrap3:   LD incoming
+         JMZ next3
+         ST carry
+next3:   LD carry
+         ST incoming
+         LD y0
+         ST x0
+         LD z0
+         ST y0
+         LD y1
+         ST x1
+         LD z1
+         ST y1
+         LD y2
+         ST x2
+         LD z2
+         ST y2
+         LD y3
+         ST x3
+         LD z3
+         ST y3
+         JMP loop
+zero:    .byte 0
+one:     .byte 1
+carry:   .byte 0
+incoming: .byte 0
+x0:      .byte 0
+x1:      .byte 0
+x2:      .byte 0
+x3:      .byte 0
+y0:      .byte 0
+y1:      .byte 0
+y2:      .byte 0
+y3:      .byte 0
+z0:      .byte 0
+z1:      .byte 0
+z2:      .byte 0
+z3:      .byte 0
@@ -0,0 +1,30 @@
+; Tight arithmetic loops: nested counters mixing ADD, AND and NOT on a running value
+start:   LD outerCount
+         ST i
+outer:   LD innerCount
+         ST j
+inner:   LD acc
+         ADD j
+         AND mask
+         ST acc
+         NOT acc
+         ADD acc
+         ST tmp
+         LD j
+         ADD minusOne
+         ST j
+         JMZ next
+         JMP inner
+next:    LD i
+         ADD minusOne
+         ST i
+         JMZ start
+         JMP outer
+outerCount: .byte 200
+innerCount: .byte 250
+minusOne: .byte 255
+mask:    .byte 0x7F
+i:       .byte 0
+j:       .byte 0
+acc:     .byte 0
+tmp:     .byte 0
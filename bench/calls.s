@@ -0,0 +1,39 @@
+; Self-modifying subroutine calls: callers store the return address into the JMP ending the subroutine
+main:    LD ret1Low
+         ST sumReturn
+         LD ret1High
+         ST sumReturn+1
+         JMP sum
+return1: LD ret2Low
+         ST sumReturn
+         LD ret2High
+         ST sumReturn+1
+         JMP sum
+return2: JMP main
+sum:     LD total
+         ADD step
+         ST total
+         LD ret3Low
+         ST leafReturn
+         LD ret3High
+         ST leafReturn+1
+         JMP leaf
+return3: LD step
+         ADD one
+         ST step
+sumReturn: JMP 0
+leaf:    LD total
+         AND mask
+         ST masked
+leafReturn: JMP 0
+ret1Low: .byte lo(return1)
+ret1High: .byte 0xA0 | hi(return1)
+ret2Low: .byte lo(return2)
+ret2High: .byte 0xA0 | hi(return2)
+ret3Low: .byte lo(return3)
+ret3High: .byte 0xA0 | hi(return3)
+one:     .byte 1
+mask:    .byte 0x0F
+total:   .byte 0
+step:    .byte 1
+masked:  .byte 0
@@ -0,0 +1,24 @@
+; Memory copies: copies a 256-byte block with self-modifying LD and ST instructions, whose address bytes are incremented
+start:   LD zero
+         ST load
+         ST store
+         ST count
+copy:
+load:    LD 0x0100
+store:   ST 0x0200
+         LD load
+         ADD one
+         ST load
+         LD store
+         ADD one
+         ST store
+         LD count
+         ADD one
+         ST count
+         JMZ start
+         JMP copy
+zero:    .byte 0
+one:     .byte 1
+count:   .byte 0
+         .org 0x0100
+source:  .byte 1, 2, 3, 5, 8, 13, 21, 34, 55, 89, 144, 233, 121, 98, 219, 61
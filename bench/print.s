@@ -0,0 +1,15 @@
+; Output-heavy printing: prints a line repeatedly, reading its characters with a self-modifying LD instruction
+start:   LD messageLow
+         ST print
+print:   LD message
+         JMZ start
+         ST 0x1FFF
+         LD print
+         ADD one
+         ST print
+         JMP print
+messageLow: .byte lo(message)
+one:     .byte 1
+         .org 0x0100
+message: .ascii "The quick brown fox jumps over the lazy dog. 0123456789 W13!\n"
+         .byte 0
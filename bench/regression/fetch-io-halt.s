@@ -0,0 +1,3 @@
+; Falls through zeroed memory (LD 0x0000) until the instruction at 0x1FFE, whose fetch reads the terminal I/O register.
+; With no input, the fetch ends the run, so every engine must stop at the same clock cycle.
+start:   LD start
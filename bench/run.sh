@@ -0,0 +1,75 @@
+#!/bin/sh
+# Runs every benchmark with every engine and reports the throughput.
+# Usage: bench/run.sh path/to/w13sim [repetitions] [clock cycles per run]
+
+simulator=${1:?"path to the simulator was not provided"}
+repetitions=${2:-5}
+cycles=${3:-200000000}
+benchDirectory=$(dirname "$0")
+engines="switch threaded"
+
+# The JIT engine falls back to the threaded engine on other hosts
+if [ "$(uname -m)" = "x86_64" ]; then engines="$engines jit"; fi
+
+# The cycle engine simulates every clock cycle, which is about 10 times slower, so it runs a tenth of the clock cycles
+engines="$engines cycle"
+cycleEngineCycles=$((cycles / 10))
+
+# Benchmarks are deterministic, so instructions are counted once by the profiler
+countInstructions() {
+    profile=$(mktemp)
+    "$simulator" --headless --max-cycles "$2" --profile "$profile" "$1" < /dev/null > /dev/null
+    awk 'NR == 1 { print $1 }' "$profile"
+    rm -f "$profile"
+}
+
+# Every engine must stop after the same instruction, including when fetching it ends the input
+for binary in "$benchDirectory"/regression/*.bin; do
+    expected=""
+    for engine in $engines; do
+        statistics=$("$simulator" --headless --stats --max-cycles "$cycles" --engine "$engine" "$binary" < /dev/null 2>&1 > /dev/null)
+        engineCycles=$(echo "$statistics" | awk '/^Statistics:/ { print $2 }')
+        if [ -z "$expected" ]; then expected=$engineCycles; fi
+        if [ "$engineCycles" != "$expected" ]; then
+            echo "Error: $(basename "$binary" .bin) ran $engineCycles clock cycles with the $engine engine instead of $expected."
+            exit 1
+        fi
+    done
+done
+
+echo "$repetitions runs of $cycles clock cycles ($cycleEngineCycles with the cycle engine), mean ± standard deviation"
+printf "%-12s %-9s %12s %18s %18s %18s\n" "Benchmark" "Engine" "Instructions" "Wall time [ms]" "MIPS" "M cycles/s"
+
+for binary in "$benchDirectory"/*.bin; do
+    name=$(basename "$binary" .bin)
+
+    instructions=$(countInstructions "$binary" "$cycles")
+    cycleEngineInstructions=$(countInstructions "$binary" "$cycleEngineCycles")
+
+    for engine in $engines; do
+        runCycles=$cycles
+        runInstructions=$instructions
+        if [ "$engine" = "cycle" ]; then
+            runCycles=$cycleEngineCycles
+            runInstructions=$cycleEngineInstructions
+        fi
+
+        i=0
+        while [ $i -lt "$repetitions" ]; do
+            "$simulator" --headless --stats --max-cycles "$runCycles" --engine "$engine" "$binary" < /dev/null 2>&1 > /dev/null
+            i=$((i + 1))
+        done | awk -v name="$name" -v engine="$engine" -v instructions="$runInstructions" '
+            /^Statistics:/ {
+                cycles = $2; ms = $6
+                n++; sum += ms; sumSquares += ms * ms
+                mips = instructions / ms / 1e3; mipsSum += mips; mipsSumSquares += mips * mips
+                mcps = cycles / ms / 1e3; mcpsSum += mcps; mcpsSumSquares += mcps * mcps
+            }
+            function deviation(s, s2) { v = s2 / n - (s / n) ^ 2; return v > 0 ? sqrt(v) : 0 }
+            END {
+                if (n == 0) { printf "%-12s %-9s failed\n", name, engine; exit }
+                printf "%-12s %-9s %12d %10.1f ± %5.1f %10.1f ± %5.1f %10.1f ± %5.1f\n", name, engine, instructions,
+                    sum / n, deviation(sum, sumSquares), mipsSum / n, deviation(mipsSum, mipsSumSquares), mcpsSum / n, deviation(mcpsSum, mcpsSumSquares)
+            }'
+    done
+done
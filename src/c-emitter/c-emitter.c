@@ -0,0 +1,295 @@
+#include "c-emitter.h"
+#include "../machine-state/machine-state.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+#define FIRST_UNCOMPILED_ADDRESS (TIME_INTERFACE_ADDRESS - 1) // instructions from here on overlap memory-mapped registers
+
+// Terminal I/O and clock runtime of the generated program. Mirrors keyboard-input.c and the memory-mapped registers of machine-state.c.
+static const char* runtimeSource =
+"#include <stdio.h>\n"
+"#include <stdlib.h>\n"
+"#include <stdbool.h>\n"
+"#include <string.h>\n"
+"#include <signal.h>\n"
+"#include <stdatomic.h>\n"
+"#include <pthread.h>\n"
+"#include <termios.h>\n"
+"#include <time.h>\n"
+"#include <unistd.h>\n"
+"\n"
+"#pragma GCC diagnostic ignored \"-Wunused-label\"\n"
+"\n"
+"#define ADDRESS_SPACE_SIZE 0x2000\n"
+"#define IO_INTERFACE_ADDRESS 0x1fff\n"
+"#define TIME_INTERFACE_ADDRESS 0x1ffb\n"
+"\n"
+"static unsigned char memory[ADDRESS_SPACE_SIZE];\n"
+"static const unsigned char initialMemory[ADDRESS_SPACE_SIZE];\n"
+"static const bool isLabel[ADDRESS_SPACE_SIZE];\n"
+"static const bool isConstantCode[ADDRESS_SPACE_SIZE];\n"
+"static int modifiedCodeBytes = 0; // constant code bytes that differ from initialMemory\n"
+"static _Atomic unsigned char inputRegister = 0;\n"
+"static unsigned long startTimeMs;\n"
+"static unsigned long measuredTimeMs;\n"
+"static struct termios initialTerminalAttributes;\n"
+"\n"
+"static unsigned long getTimeMs(void) {\n"
+"    struct timespec now;\n"
+"    clock_gettime(CLOCK_MONOTONIC, &now);\n"
+"    return now.tv_sec * 1000 + now.tv_nsec / 1000000;\n"
+"}\n"
+"\n"
+"static void* readInput(void* _) {\n"
+"    for (;;) {\n"
+"        int ch = getchar();\n"
+"        if (ch < 0) {\n"
+"            clearerr(stdin);\n"
+"            usleep(10000);\n"
+"        } else {\n"
+"            atomic_store(&inputRegister, ch);\n"
+"        }\n"
+"    }\n"
+"    return NULL;\n"
+"}\n"
+"\n"
+"static void restoreTerminal(void) {\n"
+"    tcsetattr(STDIN_FILENO, TCSANOW, &initialTerminalAttributes);\n"
+"}\n"
+"\n"
+"static void handleSigInt(int _) {\n"
+"    restoreTerminal();\n"
+"    _exit(0);\n"
+"}\n"
+"\n"
+"static void startRuntime(void) {\n"
+"    memcpy(memory, initialMemory, ADDRESS_SPACE_SIZE);\n"
+"    startTimeMs = getTimeMs();\n"
+"    measuredTimeMs = 0;\n"
+"\n"
+"    tcgetattr(STDIN_FILENO, &initialTerminalAttributes);\n"
+"    struct termios attr = initialTerminalAttributes;\n"
+"    attr.c_lflag &= ~(ICANON | ECHO);\n"
+"    attr.c_cc[VMIN] = 1;\n"
+"    attr.c_cc[VTIME] = 0;\n"
+"    tcsetattr(STDIN_FILENO, TCSANOW, &attr);\n"
+"    signal(SIGINT, handleSigInt);\n"
+"\n"
+"    pthread_t thread;\n"
+"    pthread_create(&thread, NULL, readInput, NULL);\n"
+"    pthread_detach(thread);\n"
+"}\n"
+"\n"
+"static void halt(void) {\n"
+"    restoreTerminal();\n"
+"    exit(0);\n"
+"}\n"
+"\n"
+"static unsigned char readMemory(unsigned short address) {\n"
+"    address %= ADDRESS_SPACE_SIZE;\n"
+"    switch (address) {\n"
+"        case IO_INTERFACE_ADDRESS:\n"
+"            return atomic_exchange(&inputRegister, 0);\n"
+"        case TIME_INTERFACE_ADDRESS:\n"
+"            measuredTimeMs = getTimeMs() - startTimeMs;\n"
+"            return measuredTimeMs;\n"
+"        case TIME_INTERFACE_ADDRESS + 1:\n"
+"        case TIME_INTERFACE_ADDRESS + 2:\n"
+"        case TIME_INTERFACE_ADDRESS + 3:\n"
+"            return measuredTimeMs >> ((address - TIME_INTERFACE_ADDRESS) * 8);\n"
+"        default:\n"
+"            return memory[address];\n"
+"    }\n"
+"}\n"
+"\n"
+"static void writeOutput(unsigned char value) {\n"
+"    putchar(value);\n"
+"    fflush(stdout);\n"
+"}\n"
+"\n"
+"static void writeMemory(unsigned short address, unsigned char value) {\n"
+"    if (address == IO_INTERFACE_ADDRESS) {\n"
+"        writeOutput(value);\n"
+"        return;\n"
+"    }\n"
+"    if (isConstantCode[address] && value != memory[address]) {\n"
+"        if (memory[address] == initialMemory[address]) ++modifiedCodeBytes;\n"
+"        else if (value == initialMemory[address]) --modifiedCodeBytes;\n"
+"    }\n"
+"    memory[address] = value;\n"
+"}\n"
+"\n"
+"// Executes one instruction from memory and returns the address of the next one\n"
+"static unsigned short interpretInstruction(unsigned short pc, unsigned char* A) {\n"
+"    unsigned short instruction = readMemory(pc) | (readMemory(pc + 1) << 8);\n"
+"    unsigned short argument = instruction & 0x1fff;\n"
+"    unsigned short next = (pc + 2) % ADDRESS_SPACE_SIZE;\n"
+"    switch (instruction >> 13) {\n"
+"        case 0: *A = readMemory(argument); return next;\n"
+"        case 1: *A = ~readMemory(argument); return next;\n"
+"        case 2: *A += readMemory(argument); return next;\n"
+"        case 3: *A &= readMemory(argument); return next;\n"
+"        case 4: writeMemory(argument, *A); return next;\n"
+"        case 5: if (argument == pc) halt(); return argument;\n"
+"        case 6: return (*A & 0x80) ? argument : next;\n"
+"        default: return *A == 0 ? argument : next;\n"
+"    }\n"
+"}\n"
+"\n";
+
+static unsigned short getWord(struct MachineState* state, unsigned short address) {
+    return state->memory[address] | (state->memory[address + 1] << 8);
+}
+
+static void emitJumpToAddress(unsigned short address, bool* reachable, FILE* output) {
+    if (address < FIRST_UNCOMPILED_ADDRESS && reachable[address]) {
+        fprintf(output, "goto L_%04X;", address);
+    } else {
+        fprintf(output, "pc = 0x%04X; goto interpret;", address);
+    }
+}
+
+static void emitInstruction(struct MachineState* state, unsigned short address, bool* reachable, bool* storeTargets, FILE* output) {
+    unsigned short instruction = getWord(state, address);
+    unsigned char opcode = instruction >> 13;
+    unsigned short argument = instruction & 0x1fff;
+    unsigned short next = address + 2;
+
+    fprintf(output, "L_%04X:\n", address);
+
+    if (opcode >= 5) {
+        // The jump is read from memory, so that subroutine returns patched by the caller work without the interpreter
+        fprintf(output, "    word = memory[0x%04X] | (memory[0x%04X] << 8);\n", address, address + 1);
+        fprintf(output, "    if ((word >> 13) != %d) { pc = 0x%04X; goto interpret; }\n", opcode, address);
+
+        if (opcode == 5) { // JMP
+            fprintf(output, "    pc = word & 0x1fff;\n");
+            fprintf(output, "    if (pc == 0x%04X) halt();\n", address);
+        } else {
+            fprintf(output, "    if (%s) {\n", opcode == 6 ? "A & 0x80" : "A == 0");
+            fprintf(output, "        pc = word & 0x1fff;\n");
+        }
+
+        if (argument < FIRST_UNCOMPILED_ADDRESS && reachable[argument]) {
+            fprintf(output, "    if (pc == 0x%04X) goto L_%04X;\n", argument, argument);
+        }
+        fprintf(output, "    goto dispatch;\n");
+
+        if (opcode == 5) return;
+
+        fprintf(output, "    }\n");
+    } else {
+        if (storeTargets[address] || storeTargets[address + 1]) {
+            fprintf(output, "    if (memory[0x%04X] != 0x%02X || memory[0x%04X] != 0x%02X) { pc = 0x%04X; goto interpret; }\n",
+                address, state->memory[address], address + 1, state->memory[address + 1], address);
+        }
+
+        const char* source = argument >= TIME_INTERFACE_ADDRESS ? "readMemory(0x%04X)" : "memory[0x%04X]";
+
+        switch (opcode) {
+            case 0: fprintf(output, "    A = "); break; // LD
+            case 1: fprintf(output, "    A = ~"); break; // NOT
+            case 2: fprintf(output, "    A += "); break; // ADD
+            case 3: fprintf(output, "    A &= "); break; // AND
+        }
+
+        if (opcode < 4) {
+            fprintf(output, source, argument);
+            fprintf(output, ";\n");
+        } else if (argument == IO_INTERFACE_ADDRESS) { // ST
+            fprintf(output, "    writeOutput(A);\n");
+        } else {
+            fprintf(output, "    memory[0x%04X] = A;\n", argument);
+        }
+    }
+
+    bool nextIsEmitted = next < FIRST_UNCOMPILED_ADDRESS && reachable[next];
+    bool nextFollows = nextIsEmitted;
+    for (int i = address + 1; i < next && nextFollows; ++i) {
+        if (reachable[i]) nextFollows = false;
+    }
+
+    if (!nextFollows) {
+        fprintf(output, "    ");
+        emitJumpToAddress(next, reachable, output);
+        fprintf(output, "\n");
+    }
+}
+
+void emitC(struct MachineState* state, const char* binaryFilePath, FILE* output) {
+    static bool reachable[ADDRESS_SPACE_SIZE] = { false };
+    static bool entryPoints[ADDRESS_SPACE_SIZE] = { false };
+    static bool storeTargets[ADDRESS_SPACE_SIZE] = { false };
+    static bool constantCode[ADDRESS_SPACE_SIZE] = { false };
+
+    findReachableInstructions(state, reachable, entryPoints);
+
+    for (int address = 0; address < FIRST_UNCOMPILED_ADDRESS; ++address) {
+        unsigned short instruction = getWord(state, address);
+        if (reachable[address] && instruction >> 13 == 4) { // ST
+            storeTargets[instruction & 0x1fff] = true;
+        }
+    }
+
+    // Bytes of compiled instructions that are neither checked before execution nor read at run time
+    for (int address = 0; address < FIRST_UNCOMPILED_ADDRESS; ++address) {
+        if (reachable[address] && getWord(state, address) >> 13 < 5 && !storeTargets[address] && !storeTargets[address + 1]) {
+            constantCode[address] = true;
+            constantCode[address + 1] = true;
+        }
+    }
+
+    fprintf(output, "// Generated by w13sim --emit-c from \"%s\".\n\n", binaryFilePath);
+    fprintf(output, "%s", runtimeSource);
+
+    int memoryLength = ADDRESS_SPACE_SIZE;
+    while (memoryLength > 0 && state->memory[memoryLength - 1] == 0) --memoryLength;
+
+    fprintf(output, "static const unsigned char initialMemory[ADDRESS_SPACE_SIZE] = {");
+    for (int address = 0; address < memoryLength; ++address) {
+        fprintf(output, "%s0x%02X,", address % 16 == 0 ? "\n    " : " ", state->memory[address]);
+    }
+    fprintf(output, "\n};\n\n");
+
+    fprintf(output, "static const bool isLabel[ADDRESS_SPACE_SIZE] = {\n");
+    for (int address = 0; address < ADDRESS_SPACE_SIZE; ++address) {
+        if (entryPoints[address]) fprintf(output, "    [0x%04X] = true,\n", address);
+    }
+    fprintf(output, "};\n\n");
+
+    fprintf(output, "static const bool isConstantCode[ADDRESS_SPACE_SIZE] = {\n");
+    for (int address = 0; address < ADDRESS_SPACE_SIZE; ++address) {
+        if (constantCode[address]) fprintf(output, "    [0x%04X] = true,\n", address);
+    }
+    fprintf(output, "};\n\n");
+
+    fprintf(output, "int main(void) {\n");
+    fprintf(output, "    unsigned short pc = 0;\n");
+    fprintf(output, "    unsigned short word;\n");
+    fprintf(output, "    unsigned char A = 0;\n\n");
+    fprintf(output, "    startRuntime();\n");
+    fprintf(output, "    goto L_0000;\n\n");
+
+    fprintf(output, "dispatch:\n");
+    fprintf(output, "    switch (pc) {\n");
+    for (int address = 0; address < ADDRESS_SPACE_SIZE; ++address) {
+        if (entryPoints[address]) fprintf(output, "        case 0x%04X: goto L_%04X;\n", address, address);
+    }
+    fprintf(output, "        default: goto interpret;\n");
+    fprintf(output, "    }\n\n");
+
+    fprintf(output, "    // Runs code that isn't compiled, or was modified, until it reaches an entry point of unmodified code\n");
+    fprintf(output, "interpret:\n");
+    fprintf(output, "    do {\n");
+    fprintf(output, "        pc = interpretInstruction(pc, &A);\n");
+    fprintf(output, "    } while (modifiedCodeBytes != 0 || !isLabel[pc]);\n");
+    fprintf(output, "    goto dispatch;\n\n");
+
+    for (int address = 0; address < FIRST_UNCOMPILED_ADDRESS; ++address) {
+        if (reachable[address]) {
+            emitInstruction(state, address, reachable, storeTargets, output);
+        }
+    }
+
+    fprintf(output, "}\n");
+}
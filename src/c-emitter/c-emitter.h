@@ -0,0 +1,10 @@
+#ifndef c_emitter
+#define c_emitter
+
+#include "../machine-state/machine-state.h"
+#include <stdio.h>
+
+// Writes a C program equivalent to running the simulator on the state's memory, with a label per reachable instruction
+void emitC(struct MachineState* state, const char* binaryFilePath, FILE* output);
+
+#endif
@@ -0,0 +1,225 @@
+#include "call-graph.h"
+#include "../machine-state/machine-state.h"
+#include "../symbols/symbols.h"
+#include "../profiler/profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define REPORTED_SUBROUTINES 20
+
+struct SubroutineEntry {
+    unsigned short entry;
+    unsigned long long calls;
+    unsigned long long inclusiveCycles;
+    unsigned long long exclusiveCycles;
+};
+
+struct CallGraph* createCallGraph(struct Symbols* symbols) {
+    struct CallGraph* graph = calloc(1, sizeof(struct CallGraph));
+    graph->symbols = symbols;
+    graph->armedReturnAddress = -1;
+    return graph;
+}
+
+void destroyCallGraph(struct CallGraph* graph) {
+    free(graph->nodes);
+    free(graph);
+}
+
+static int addNode(struct CallGraph* graph, unsigned short entry, int parent) {
+    if (graph->nodeCount == graph->nodeCapacity) {
+        graph->nodeCapacity = graph->nodeCapacity == 0 ? 64 : graph->nodeCapacity * 2;
+        graph->nodes = realloc(graph->nodes, graph->nodeCapacity * sizeof(struct CallGraphNode));
+    }
+
+    int node = graph->nodeCount++;
+    graph->nodes[node] = (struct CallGraphNode) { entry, parent, -1, -1, 0, 0 };
+
+    if (parent >= 0) {
+        graph->nodes[node].nextSibling = graph->nodes[parent].firstChild;
+        graph->nodes[parent].firstChild = node;
+    }
+
+    return node;
+}
+
+static void attributeCycles(struct CallGraph* graph, struct MachineState* state) {
+    graph->nodes[graph->stack[graph->depth - 1].node].exclusiveCycles += state->cycleCount - graph->attributedCycleCount;
+    graph->attributedCycleCount = state->cycleCount;
+}
+
+// Data next to a stored variable may look like a JMP, so it also has to be code
+static bool isReturnJmpAt(struct CallGraph* graph, struct MachineState* state, int address) {
+    if (address < 0 || address >= TIME_INTERFACE_ADDRESS - 1) return false;
+
+    bool isCode = graph->isCode[address] || graph->symbols->dataTypes[address] == DataTypeInstruction;
+    return isCode && getDecodedInstruction(state, address).opcode == 5;
+}
+
+// Both bytes of an instruction hold bits of its argument
+static void recordStore(struct CallGraph* graph, struct MachineState* state, unsigned short address) {
+    int armed = graph->armedReturnAddress;
+    if (armed == address || armed == address - 1) return; // the other byte of an armed return address
+
+    if (isReturnJmpAt(graph, state, address)) {
+        graph->armedReturnAddress = address;
+    } else if (isReturnJmpAt(graph, state, address - 1)) {
+        graph->armedReturnAddress = address - 1;
+    }
+}
+
+static void recordTakenJump(struct CallGraph* graph, struct MachineState* state, unsigned short address) {
+    attributeCycles(graph, state);
+
+    // Returning from any subroutine on the stack also returns from the ones it called
+    for (int i = graph->depth - 1; i > 0; --i) {
+        if (graph->stack[i].returnAddress == address) {
+            graph->depth = i;
+            graph->armedReturnAddress = -1;
+            return;
+        }
+    }
+
+    int returnAddress = graph->armedReturnAddress;
+    graph->armedReturnAddress = -1;
+
+    if (returnAddress < 0 || graph->depth == MAX_CALL_DEPTH || !isReturnJmpAt(graph, state, returnAddress)) return;
+
+    bool returnsAfterJump = getDecodedInstruction(state, returnAddress).argument == (address + 2) % ADDRESS_SPACE_SIZE;
+    if (!returnsAfterJump && graph->symbols->dataTypes[returnAddress] != DataTypeInstruction) return;
+
+    int parent = graph->stack[graph->depth - 1].node;
+    int node = graph->nodes[parent].firstChild;
+    while (node >= 0 && graph->nodes[node].entry != state->PC) node = graph->nodes[node].nextSibling;
+    if (node < 0) node = addNode(graph, state->PC, parent);
+
+    ++graph->nodes[node].calls;
+    graph->stack[graph->depth++] = (struct CallFrame) { node, returnAddress };
+}
+
+unsigned long runCallGraph(struct MachineState* state, void* context, unsigned long cycleBudget) {
+    struct CallGraph* graph = context;
+    struct Profile* profile = &graph->profile;
+    unsigned long cycles = 0;
+
+    if (graph->depth == 0) {
+        bool* entryPoints = calloc(ADDRESS_SPACE_SIZE, sizeof(bool));
+        findReachableInstructions(state, graph->isCode, entryPoints);
+        free(entryPoints);
+
+        graph->stack[graph->depth++] = (struct CallFrame) { addNode(graph, state->PC, -1), 0 };
+        graph->nodes[0].calls = 1;
+        graph->attributedCycleCount = state->cycleCount;
+    }
+
+    do {
+        unsigned short PC = state->PC;
+
+        // Fetching instructions at the end of memory has side effects, so they are decoded without them
+        struct DecodedInstruction instruction = PC < TIME_INTERFACE_ADDRESS - 1
+            ? getDecodedInstruction(state, PC)
+            : (struct DecodedInstruction) { peekInstruction(state, PC) & 0x1fff, peekInstruction(state, PC) >> 13, 0 };
+
+        cycles += step(state);
+        graph->isCode[PC] = true;
+
+        ++profile->runStarts[PC];
+        ++profile->runEnds[PC + 2];
+
+        if (instruction.opcode == 4 && instruction.argument < TIME_INTERFACE_ADDRESS) {
+            recordStore(graph, state, instruction.argument);
+        } else if (instruction.opcode >= 5) {
+            ++profile->jumps[PC];
+            bool isTaken = state->PC != (PC + 2) % ADDRESS_SPACE_SIZE && state->haltReason == HaltReasonNone;
+            if (isTaken) recordTakenJump(graph, state, PC);
+        }
+    } while (cycles < cycleBudget && state->haltReason == HaltReasonNone);
+
+    attributeCycles(graph, state);
+
+    return cycles;
+}
+
+static void writeSubroutineName(struct CallGraph* graph, unsigned short entry, FILE* output) {
+    char* labelName = graph->symbols->labelNames[entry];
+
+    if (labelName != NULL) fprintf(output, "%s", labelName);
+    else fprintf(output, "0x%04X", entry);
+}
+
+static void writeStack(struct CallGraph* graph, int node, FILE* output) {
+    if (graph->nodes[node].parent >= 0) {
+        writeStack(graph, graph->nodes[node].parent, output);
+        fprintf(output, ";");
+    }
+
+    writeSubroutineName(graph, graph->nodes[node].entry, output);
+}
+
+void writeFoldedStacks(struct CallGraph* graph, FILE* output) {
+    for (int i = 0; i < graph->nodeCount; ++i) {
+        if (graph->nodes[i].exclusiveCycles == 0) continue;
+
+        writeStack(graph, i, output);
+        fprintf(output, " %llu\n", graph->nodes[i].exclusiveCycles);
+    }
+}
+
+static int compareSubroutinesByInclusiveCycles(const void* a, const void* b) {
+    const struct SubroutineEntry* entryA = a;
+    const struct SubroutineEntry* entryB = b;
+
+    if (entryA->inclusiveCycles != entryB->inclusiveCycles) return entryA->inclusiveCycles < entryB->inclusiveCycles ? 1 : -1;
+    return entryA->entry - entryB->entry;
+}
+
+void writeCallGraphReport(struct CallGraph* graph, FILE* output) {
+    struct SubroutineEntry* subroutines = calloc(ADDRESS_SPACE_SIZE, sizeof(struct SubroutineEntry));
+    unsigned long long* subtreeCycles = calloc(graph->nodeCount, sizeof(unsigned long long));
+    unsigned long long totalCycles = 0;
+
+    // Children are always added after their parents
+    for (int i = graph->nodeCount - 1; i >= 0; --i) {
+        subtreeCycles[i] += graph->nodes[i].exclusiveCycles;
+        if (graph->nodes[i].parent >= 0) subtreeCycles[graph->nodes[i].parent] += subtreeCycles[i];
+    }
+
+    for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) subroutines[i].entry = i;
+
+    for (int i = 0; i < graph->nodeCount; ++i) {
+        struct CallGraphNode* node = &graph->nodes[i];
+        struct SubroutineEntry* subroutine = &subroutines[node->entry];
+
+        subroutine->calls += node->calls;
+        subroutine->exclusiveCycles += node->exclusiveCycles;
+        totalCycles += node->exclusiveCycles;
+
+        // Cycles of recursive calls are already included in the outermost call
+        bool isRecursive = false;
+        for (int ancestor = node->parent; ancestor >= 0 && !isRecursive; ancestor = graph->nodes[ancestor].parent) {
+            isRecursive = graph->nodes[ancestor].entry == node->entry;
+        }
+
+        if (!isRecursive) subroutine->inclusiveCycles += subtreeCycles[i];
+    }
+
+    qsort(subroutines, ADDRESS_SPACE_SIZE, sizeof(struct SubroutineEntry), compareSubroutinesByInclusiveCycles);
+
+    double cyclesPercent = totalCycles != 0 ? 100.0 / totalCycles : 0;
+
+    fprintf(output, "\nHottest subroutines:\n");
+    fprintf(output, "%14s  %7s  %14s  %7s  %12s  %s\n", "Inclusive", "%", "Exclusive", "%", "Calls", "Subroutine");
+
+    for (int i = 0; i < REPORTED_SUBROUTINES && subroutines[i].inclusiveCycles != 0; ++i) {
+        struct SubroutineEntry* subroutine = &subroutines[i];
+
+        fprintf(output, "%14llu  %7.3f  %14llu  %7.3f  %12llu  ", subroutine->inclusiveCycles, subroutine->inclusiveCycles * cyclesPercent,
+            subroutine->exclusiveCycles, subroutine->exclusiveCycles * cyclesPercent, subroutine->calls);
+        writeSubroutineName(graph, subroutine->entry, output);
+        fprintf(output, "\n");
+    }
+
+    free(subroutines);
+    free(subtreeCycles);
+}
@@ -0,0 +1,55 @@
+#ifndef call_graph
+#define call_graph
+
+#include "../machine-state/machine-state.h"
+#include "../symbols/symbols.h"
+#include "../profiler/profiler.h"
+#include <stdio.h>
+
+#define MAX_CALL_DEPTH 256
+
+// A distinct call stack, identified by the entry addresses of its subroutines
+struct CallGraphNode {
+    unsigned short entry;
+    int parent; // -1 for the root
+    int firstChild; // -1 if none
+    int nextSibling; // -1 if none
+    unsigned long long calls;
+    unsigned long long exclusiveCycles;
+};
+
+struct CallFrame {
+    int node;
+    unsigned short returnAddress; // address of the JMP instruction which returns from the subroutine
+};
+
+// W13 has no call instruction, so subroutines return with a JMP instruction whose argument the caller stores before
+// jumping to the subroutine. A store into the argument of a JMP that is code arms a return address, and the next taken jump
+// calls a subroutine if the JMP returns right after it, or if the JMP is marked as an instruction in the symbols.
+struct CallGraph {
+    struct Profile profile; // filled like by the profiling engine
+    struct Symbols* symbols;
+    bool isCode[ADDRESS_SPACE_SIZE]; // statically reachable or executed instructions
+    int armedReturnAddress; // -1 if no JMP argument was stored since the last taken jump
+    struct CallFrame stack[MAX_CALL_DEPTH];
+    int depth; // 0 before the first run
+    unsigned long long attributedCycleCount; // cycle count of the machine when cycles were last attributed to a node
+    struct CallGraphNode* nodes;
+    int nodeCount;
+    int nodeCapacity;
+};
+
+struct CallGraph* createCallGraph(struct Symbols* symbols);
+
+void destroyCallGraph(struct CallGraph* graph);
+
+// Has the same semantics as repeatedly calling step(), and builds the call graph passed as the context
+unsigned long runCallGraph(struct MachineState* state, void* graph, unsigned long cycleBudget);
+
+// Writes every call stack with the cycles spent in its innermost subroutine, in the folded format of flame graph tools
+void writeFoldedStacks(struct CallGraph* graph, FILE* output);
+
+// Writes the subroutines with the most inclusive cycles, and their exclusive cycles
+void writeCallGraphReport(struct CallGraph* graph, FILE* output);
+
+#endif
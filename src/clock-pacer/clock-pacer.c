@@ -0,0 +1,45 @@
+#include "clock-pacer.h"
+#include "../time/time.h"
+
+#define UNLIMITED_BATCH_CYCLES 0x10000
+#define MAX_LAG_NS 100000000ull
+
+struct ClockPacer getClockPacer(int clockFrequencyKiloHz) {
+    struct ClockPacer pacer = {
+        clockFrequencyKiloHz,
+        clockFrequencyKiloHz == UNLIMITED_CLOCK_FREQUENCY ? UNLIMITED_BATCH_CYCLES : clockFrequencyKiloHz, // 1 ms worth of cycles
+        0,
+        0
+    };
+    resetClockPacer(&pacer);
+    return pacer;
+}
+
+void resetClockPacer(struct ClockPacer* pacer) {
+    pacer->startTimeNs = getTimeNs();
+    pacer->elapsedCycles = 0;
+}
+
+void paceClock(struct ClockPacer* pacer, unsigned long cycles) {
+    if (pacer->clockFrequencyKiloHz == UNLIMITED_CLOCK_FREQUENCY) return;
+
+    pacer->elapsedCycles += cycles;
+
+    unsigned long long cyclesPerSecond = pacer->clockFrequencyKiloHz * 1000ull;
+
+    // Move whole seconds into the start time, so that the deadline computation can't overflow
+    while (pacer->elapsedCycles >= cyclesPerSecond) {
+        pacer->elapsedCycles -= cyclesPerSecond;
+        pacer->startTimeNs += 1000000000ull;
+    }
+
+    unsigned long long deadline = pacer->startTimeNs + pacer->elapsedCycles * 1000000ull / pacer->clockFrequencyKiloHz;
+    unsigned long long now = getTimeNs();
+
+    if (now < deadline) {
+        sleepUntilNs(deadline);
+    } else if (now - deadline > MAX_LAG_NS) {
+        // The host couldn't keep up for too long (or the process was suspended), so don't try to catch up in a burst
+        resetClockPacer(pacer);
+    }
+}
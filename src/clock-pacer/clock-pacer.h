@@ -0,0 +1,21 @@
+#ifndef clock_pacer
+#define clock_pacer
+
+#define UNLIMITED_CLOCK_FREQUENCY 0
+
+struct ClockPacer {
+    int clockFrequencyKiloHz;
+    unsigned long batchCycles; // number of clock cycles to execute between calls to paceClock
+    unsigned long long startTimeNs;
+    unsigned long long elapsedCycles;
+};
+
+struct ClockPacer getClockPacer(int clockFrequencyKiloHz);
+
+// Forgets the accumulated timing debt, e.g. after the simulation was paused
+void resetClockPacer(struct ClockPacer* pacer);
+
+// Accounts for executed clock cycles and sleeps until the deadline of the last executed cycle
+void paceClock(struct ClockPacer* pacer, unsigned long cycles);
+
+#endif
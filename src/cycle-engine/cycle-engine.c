@@ -0,0 +1,222 @@
+#include "cycle-engine.h"
+#include "../machine-state/machine-state.h"
+#include "../terminal-output/terminal-output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const signalNames[CONTROL_SIGNAL_COUNT] = {
+    "rd", "wr", "outPC", "outIR", "outA", "outData", "inALU", "incPC", "inPC", "inIR_L", "inIR_H", "inA", "inAddr", "inData"
+};
+
+// Signals activated by the state machine in each state
+static const unsigned short stateSignals[8] = {
+    ControlSignalRd | ControlSignalOutData | ControlSignalInIRL | ControlSignalIncPC,
+    ControlSignalRd | ControlSignalOutData | ControlSignalInIRH | ControlSignalIncPC,
+    ControlSignalOutIR | ControlSignalInAddr,
+    ControlSignalOutIR | ControlSignalInAddr | ControlSignalOutA | ControlSignalInData,
+    ControlSignalOutIR | ControlSignalInPC | ControlSignalInAddr,
+    ControlSignalOutPC | ControlSignalInAddr,
+    ControlSignalRd | ControlSignalOutData | ControlSignalInALU | ControlSignalInA | ControlSignalOutPC | ControlSignalInAddr,
+    ControlSignalWr | ControlSignalOutPC | ControlSignalInAddr
+};
+
+// Transitions of the control store table
+static unsigned char getNextState(int state, int opcode, bool N, bool Z) {
+    switch (state) {
+        case 0: return 1;
+        case 1:
+            if (opcode < 4) return 2; // LD, NOT, ADD, AND
+            if (opcode == 4) return 3; // ST
+            return opcode == 5 || (opcode == 6 && N) || (opcode == 7 && Z) ? 4 : 5;
+        case 2: return 6;
+        case 3: return 7;
+        default: return 0;
+    }
+}
+
+static inline int getControlStoreIndex(struct Microarchitecture* m) {
+    return m->state << 5 | m->IR >> 13 << 2 | m->A >> 7 << 1 | (m->A == 0);
+}
+
+static inline void simulateCycle(const struct ControlStoreEntry* controlStore, struct Microarchitecture* m, struct MachineState* state) {
+    // The signals only depend on the state, the next state depends on IR and A loaded in this cycle
+    unsigned short signals = controlStore[m->state << 5].signals;
+    unsigned short addressBus = BUS_UNDRIVEN;
+    unsigned short dataBus = BUS_UNDRIVEN;
+
+    if (signals & ControlSignalRd) m->Data = getMemory(state, m->Addr);
+    if (signals & ControlSignalOutPC) addressBus = m->PC;
+    if (signals & ControlSignalOutIR) addressBus = m->IR & 0x1fff;
+    if (signals & ControlSignalOutData) dataBus = m->Data;
+    if (signals & ControlSignalOutA) dataBus = m->A;
+
+    if (signals & ControlSignalInALU) {
+        switch (m->IR >> 13 & 3) {
+            case 0: m->ALU = dataBus; break;
+            case 1: m->ALU = ~dataBus; break;
+            case 2: m->ALU = m->A + dataBus; break;
+            case 3: m->ALU = m->A & dataBus; break;
+        }
+    }
+
+    if (signals & ControlSignalWr) {
+        if (m->Addr == IO_INTERFACE_ADDRESS) putOutputChar(state->terminalOutput, m->Data);
+        else setMemory(state, m->Addr, m->Data);
+    }
+
+    // The state machine doesn't load Addr between the two fetch cycles, so it follows PC to read the second byte
+    if (signals & ControlSignalIncPC) {
+        m->PC = (m->PC + 1) % ADDRESS_SPACE_SIZE;
+        m->Addr = (m->Addr + 1) % ADDRESS_SPACE_SIZE;
+    }
+
+    if (signals & ControlSignalInPC) m->PC = addressBus;
+    if (signals & ControlSignalInIRL) m->IR = (m->IR & 0xff00) | dataBus;
+    if (signals & ControlSignalInIRH) m->IR = (m->IR & 0x00ff) | dataBus << 8;
+    if (signals & ControlSignalInA) m->A = m->ALU;
+    if (signals & ControlSignalInAddr) m->Addr = addressBus;
+    if (signals & ControlSignalInData) m->Data = dataBus;
+
+    m->signals = signals;
+    m->addressBus = addressBus;
+    m->dataBus = dataBus;
+    m->state = controlStore[getControlStoreIndex(m)].nextState;
+    ++state->cycleCount;
+}
+
+// Writes the state the cycle was in, and the registers after it
+static void writeCycle(FILE* traceFile, struct Microarchitecture* m, int cycleState, unsigned long long cycleCount) {
+    fprintf(traceFile, "%12llu  %d  0x%04X  0x%04X  0x%02X  0x%02X  0x%04X  0x%02X  ", cycleCount, cycleState, m->PC, m->IR, m->A, m->ALU, m->Addr, m->Data);
+    fprintf(traceFile, m->addressBus == BUS_UNDRIVEN ? "  -     " : "0x%04X  ", m->addressBus);
+    fprintf(traceFile, m->dataBus == BUS_UNDRIVEN ? " -    " : "0x%02X  ", m->dataBus);
+
+    for (int i = 0, count = 0; i < CONTROL_SIGNAL_COUNT; ++i) {
+        if (m->signals & 1 << i) fprintf(traceFile, count++ == 0 ? "%s" : " %s", signalNames[i]);
+    }
+
+    fprintf(traceFile, "\n");
+}
+
+struct CycleEngine* createCycleEngine(FILE* traceFile, bool isLockstep) {
+    struct CycleEngine* engine = calloc(1, sizeof(struct CycleEngine));
+
+    for (int i = 0; i < CONTROL_STORE_SIZE; ++i) {
+        int state = i >> 5;
+        engine->controlStore[i] = (struct ControlStoreEntry) { stateSignals[state], getNextState(state, i >> 2 & 7, i >> 1 & 1, i & 1) };
+    }
+
+    engine->traceFile = traceFile;
+
+    if (traceFile != NULL) {
+        fprintf(traceFile, "%12s  %s  %-6s  %-6s  %-4s  %-4s  %-6s  %-4s  %-6s  %-4s  %s\n", "Cycle", "S", "PC", "IR", "A", "ALU", "Addr", "Data", "AB", "DB", "Signals");
+    }
+
+    if (isLockstep) {
+        engine->reference = malloc(sizeof(struct MachineState));
+        *engine->reference = getInitialState();
+        engine->discardedOutput = getTerminalOutput(OutputBufferPolicyFull, NULL);
+        engine->reference->terminalOutput = &engine->discardedOutput;
+    }
+
+    return engine;
+}
+
+void destroyCycleEngine(struct CycleEngine* engine) {
+    if (engine->traceFile != NULL) fflush(engine->traceFile);
+    free(engine->reference);
+    free(engine);
+}
+
+void runClockCycle(struct CycleEngine* engine, struct MachineState* state) {
+    int cycleState = engine->registers.state;
+    simulateCycle(engine->controlStore, &engine->registers, state);
+    if (engine->traceFile != NULL) writeCycle(engine->traceFile, &engine->registers, cycleState, state->cycleCount);
+}
+
+static void reportDivergence(struct CycleEngine* engine, struct MachineState* state, unsigned short PC, unsigned short expectedInstruction, int cycles, int expectedCycles) {
+    struct MachineState* reference = engine->reference;
+    unsigned short argument = engine->registers.IR & 0x1fff;
+
+    flushOutput(state->terminalOutput);
+    printf("Error: the cycle-accurate engine diverged from the ISA engine at instruction %llu, PC = 0x%04X. ", engine->instructionCount, PC);
+    printf("It executed 0x%04X in %d clock cycles, resulting in PC = 0x%04X, A = 0x%02X, [0x%04X] = 0x%02X, ",
+        engine->registers.IR, cycles, engine->registers.PC, engine->registers.A, argument, state->memory[argument]);
+    printf("instead of 0x%04X in %d clock cycles, resulting in PC = 0x%04X, A = 0x%02X, [0x%04X] = 0x%02X.\n",
+        expectedInstruction, expectedCycles, reference->PC, reference->A, argument, reference->memory[argument]);
+    exit(1);
+}
+
+static void checkInstruction(struct CycleEngine* engine, struct MachineState* state, unsigned short PC, int cycles) {
+    struct MachineState* reference = engine->reference;
+    struct Microarchitecture* m = &engine->registers;
+    unsigned char opcode = m->IR >> 13;
+    unsigned short argument = m->IR & 0x1fff;
+
+    if (PC >= TIME_INTERFACE_ADDRESS - 1 || (argument >= TIME_INTERFACE_ADDRESS && opcode <= 3)) {
+        reference->PC = m->PC;
+        reference->A = m->A;
+        if (opcode == 4 && argument != IO_INTERFACE_ADDRESS) setMemory(reference, argument, state->memory[argument]);
+        return;
+    }
+
+    unsigned short instruction = peekInstruction(reference, PC);
+    int expectedCycles = step(reference);
+    bool isHalted = state->haltReason == HaltReasonInfiniteLoop;
+
+    if (instruction != m->IR || reference->PC != m->PC || reference->A != m->A || expectedCycles != cycles ||
+        (reference->haltReason == HaltReasonInfiniteLoop) != isHalted || reference->memory[argument] != state->memory[argument]) {
+        reportDivergence(engine, state, PC, instruction, cycles, expectedCycles);
+    }
+}
+
+unsigned long runCycleAccurate(struct MachineState* state, void* context, unsigned long cycleBudget) {
+    struct CycleEngine* engine = context;
+    const struct ControlStoreEntry* controlStore = engine->controlStore;
+    struct Microarchitecture m = engine->registers;
+    unsigned long cycles = 0;
+
+    // The registers may have been changed since the last run, which ended in state 0
+    m.state = 0;
+    m.PC = state->PC;
+    m.A = state->A;
+    m.Addr = state->PC;
+
+    if (engine->reference != NULL) {
+        if (!engine->isReferenceSynchronized) {
+            memcpy(engine->reference->memory, state->memory, ADDRESS_SPACE_SIZE);
+            invalidateDecodedInstructions(engine->reference);
+            engine->isReferenceSynchronized = true;
+        }
+
+        engine->reference->PC = state->PC;
+        engine->reference->A = state->A;
+    }
+
+    do {
+        unsigned short PC = m.PC;
+        unsigned long instructionStart = cycles;
+
+        do {
+            int cycleState = m.state;
+            simulateCycle(controlStore, &m, state);
+            ++cycles;
+            if (engine->traceFile != NULL) writeCycle(engine->traceFile, &m, cycleState, state->cycleCount);
+        } while (m.state != 0);
+
+        if (m.IR >> 13 == 5 && m.PC == PC) state->haltReason = HaltReasonInfiniteLoop;
+
+        if (engine->reference != NULL) {
+            engine->registers = m;
+            checkInstruction(engine, state, PC, cycles - instructionStart);
+        }
+
+        ++engine->instructionCount;
+    } while (cycles < cycleBudget && state->haltReason == HaltReasonNone);
+
+    state->PC = m.PC;
+    state->A = m.A;
+    engine->registers = m;
+
+    return cycles;
+}
@@ -0,0 +1,75 @@
+#ifndef cycle_engine_h
+#define cycle_engine_h
+
+#include "../machine-state/machine-state.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+// Control signals described in docs/microarchitecture.md. Level signals are active during the high level of the clock, and
+// impulse signals at its falling edge.
+enum ControlSignal {
+    ControlSignalRd = 1 << 0, // level signals
+    ControlSignalWr = 1 << 1,
+    ControlSignalOutPC = 1 << 2,
+    ControlSignalOutIR = 1 << 3,
+    ControlSignalOutA = 1 << 4,
+    ControlSignalOutData = 1 << 5,
+    ControlSignalInALU = 1 << 6,
+    ControlSignalIncPC = 1 << 7, // impulse signals
+    ControlSignalInPC = 1 << 8,
+    ControlSignalInIRL = 1 << 9,
+    ControlSignalInIRH = 1 << 10,
+    ControlSignalInA = 1 << 11,
+    ControlSignalInAddr = 1 << 12,
+    ControlSignalInData = 1 << 13
+};
+
+#define CONTROL_SIGNAL_COUNT 14
+#define CONTROL_STORE_SIZE 256 // indexed by state[2:0], IR[15:13], N and Z
+#define BUS_UNDRIVEN 0xffff
+
+struct ControlStoreEntry {
+    unsigned short signals;
+    unsigned char nextState;
+};
+
+// Registers of the microarchitecture, and the signals and buses of the last clock cycle
+struct Microarchitecture {
+    unsigned char state; // of the next clock cycle
+    unsigned short PC;
+    unsigned short IR;
+    unsigned char A;
+    unsigned char ALU; // result of the operation selected by IR[14:13]
+    unsigned short Addr;
+    unsigned char Data;
+    unsigned short signals;
+    unsigned short addressBus; // BUS_UNDRIVEN if no signal propagated a value to the bus
+    unsigned short dataBus;
+};
+
+// Simulates every clock cycle of the microarchitecture with the control store, instead of executing instructions
+struct CycleEngine {
+    struct ControlStoreEntry controlStore[CONTROL_STORE_SIZE];
+    struct Microarchitecture registers;
+    FILE* traceFile; // receives the registers and buses after every clock cycle if not NULL
+    struct MachineState* reference; // executes every instruction with step() in lockstep mode, NULL otherwise
+    bool isReferenceSynchronized; // the memory of the reference was copied from the machine
+    struct TerminalOutput discardedOutput; // of the reference
+    unsigned long long instructionCount;
+};
+
+// Fills the control store from the state machine. In lockstep mode, every instruction is also executed by the ISA-level
+// step() on a copy of the machine, and the simulator exits at the first difference. Instructions reading the terminal I/O or
+// clock register can't be executed twice, so the copy takes their results instead.
+struct CycleEngine* createCycleEngine(FILE* traceFile, bool isLockstep);
+
+void destroyCycleEngine(struct CycleEngine* engine);
+
+// Simulates one clock cycle. Outside of runCycleAccurate(), the state of the machine is only synchronized with the registers
+// when the microarchitecture is in state 0.
+void runClockCycle(struct CycleEngine* engine, struct MachineState* state);
+
+// Has the same semantics as repeatedly calling step() with the cycle engine passed as the context
+unsigned long runCycleAccurate(struct MachineState* state, void* engine, unsigned long cycleBudget);
+
+#endif
@@ -2,6 +2,11 @@
 #include "../machine-state/machine-state.h"
 #include "../keyboard-input/keyboard-input.h"
 #include "../time/time.h"
+#include "../clock-pacer/clock-pacer.h"
+#include "../terminal-output/terminal-output.h"
+#include "../symbols/symbols.h"
+#include "../snapshot/snapshot.h"
+#include "../history/history.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <signal.h>
@@ -11,15 +16,6 @@
 #include <errno.h>
 #include <unistd.h> // POSIX
 
-#define LABEL_NAME_MAX_LENGTH 31
-
-enum DataType {
-    DataTypeNone = 0,
-    DataTypeInstruction,
-    DataTypeChar,
-    DataTypeInt
-};
-
 enum Command {
     CommandUnknown = 0,
     CommandHelp,
@@ -33,8 +29,17 @@ enum Command {
     CommandAddBreakpoint,
     CommandDeleteBreakpoint,
     CommandDeleteAllBreakpoints,
+    CommandAddWriteWatchpoint,
+    CommandAddReadWatchpoint,
+    CommandListWatchpoints,
+    CommandDeleteWatchpoints,
+    CommandDeleteAllWatchpoints,
     CommandContinue,
     CommandStep,
+    CommandStepBack,
+    CommandReverseContinue,
+    CommandSaveSnapshot,
+    CommandLoadSnapshot,
     CommandQuit
 };
 
@@ -43,16 +48,68 @@ struct Range {
     int end;
 };
 
-static volatile bool isPaused = true;
-static bool isStepping = false;
-static char* labelNames[ADDRESS_SPACE_SIZE] = { NULL };
-static bool breakpoints[ADDRESS_SPACE_SIZE] = { false };
-static enum DataType dataTypes[ADDRESS_SPACE_SIZE] = { 
-    DataTypeNone,
-    [TIME_INTERFACE_ADDRESS] = DataTypeNone,
-    [IO_INTERFACE_ADDRESS] = DataTypeChar 
+enum WatchpointType {
+    WatchpointRead = 1,
+    WatchpointWrite = 2
+};
+
+struct WatchpointHit {
+    bool isPending; // the debugger pauses before the next instruction and prints the hit
+    enum WatchpointType type;
+    unsigned short address;
+    unsigned short instructionAddress;
+    unsigned char previousValue;
+};
+
+enum ConditionOperandType {
+    ConditionOperandNumber,
+    ConditionOperandA,
+    ConditionOperandPC,
+    ConditionOperandMemory
+};
+
+struct ConditionOperand {
+    enum ConditionOperandType type;
+    unsigned short value; // the number or the memory address
+};
+
+// In the order of matching their symbols
+enum ComparisonOperator {
+    ComparisonEqual,
+    ComparisonNotEqual,
+    ComparisonLessOrEqual,
+    ComparisonGreaterOrEqual,
+    ComparisonLess,
+    ComparisonGreater
+};
+
+static const char* comparisonOperatorSymbols[] = { "==", "!=", "<=", ">=", "<", ">" };
+
+// Breakpoint condition compiled from an expression like "A == 0x20" or "M[counter] > 10"
+struct Condition {
+    struct ConditionOperand left;
+    enum ComparisonOperator operator;
+    struct ConditionOperand right;
+    char expression[128];
+};
+
+struct Debugger {
+    volatile bool isPaused;
+    bool isStepping;
+    struct Symbols symbols;
+    bool breakpoints[ADDRESS_SPACE_SIZE];
+    struct Condition* conditions[ADDRESS_SPACE_SIZE]; // of breakpoints, NULL if a breakpoint is unconditional
+    unsigned short blockLengths[ADDRESS_SPACE_SIZE]; // instructions executed from each address before checking for breakpoints again
+    bool isBlockMapValid; // false after breakpoints change
+    unsigned char watchpoints[ADDRESS_SPACE_SIZE]; // WatchpointType flags
+    int watchpointCount; // addresses with any watchpoints, instructions aren't checked against them if 0
+    struct WatchpointHit watchpointHit;
+    unsigned long pauseStartTimeMs; // the clock register doesn't count while paused
 };
 
+// Signals are delivered to the process, so only one debugger can be interrupted with ^C
+static struct Debugger* interruptibleDebugger = NULL;
+
 static char charUppercase(char ch) {
     if (ch >= 'a' && ch <= 'z') return ch - 0x20;
     else return ch;
@@ -70,99 +127,12 @@ static bool stringsEqualCaseInsensitive(char* string1, char* string2) {
     }
 }
 
-static void parseSymbolsFile(char* path) {
-    if (path == NULL) return;
-
-    FILE* file = fopen(path, "r");
-
-    if (file == NULL) {
-        printf("Error: could not read file \"%s\".\n", path);
-        exit(1);
-    }
-
-    char line[128] = {0};
-    char* addressString;
-    char* dataTypeString;
-    char* labelName;
-    int lineNumber = 0;
-    static bool addressDescribed[ADDRESS_SPACE_SIZE] = { false };
-
-    while (fgets(line, 127, file) != NULL) {
-        ++lineNumber;
-
-        addressString = strtok(line, " ,\t\n");
-        dataTypeString = strtok(NULL, " ,\t\n");
-        labelName = strtok(NULL, " ,\t\n");
-
-        if (addressString == NULL) continue;
-        
-        if (dataTypeString == NULL) {
-            printf("Error: in file \"%s\" line %d has too few columns.\n", path, lineNumber);
-            exit(1);
-        }
-
-        int addressNumber = strtol(addressString, NULL, 0);
-        if (errno != 0) {
-            printf("Error: in file \"%s\" line %d: %s could not be parsed as a number.\n", path, lineNumber, addressString);
-            exit(1);
-        } else if (addressNumber < 0 || addressNumber >= ADDRESS_SPACE_SIZE) {
-            printf("Error: in file \"%s\" line %d: address %s is out of range.\n", path, lineNumber, addressString);
-            exit(1);
-        } else if (addressDescribed[addressNumber]) {
-            printf("Error: in file \"%s\" line %d: address 0x%04X was described multiple times.\n", path, lineNumber, addressNumber);
-            exit(1);
-        }
-        addressDescribed[addressNumber] = true;
-
-        enum DataType dataType;
-        if (stringsEqualCaseInsensitive(dataTypeString, "int")) {
-            dataType = DataTypeInt;
-        } else if (stringsEqualCaseInsensitive(dataTypeString, "char")) {
-            dataType = DataTypeChar;
-        } else if (stringsEqualCaseInsensitive(dataTypeString, "instruction")) {
-            dataType = DataTypeInstruction;
-        } else {
-            printf("Error: in file \"%s\" line %d: unknown data type \"%s\".\n", path, lineNumber, dataTypeString);
-            exit(1);
-        }
-
-        dataTypes[addressNumber] = dataType;
-
-        if (labelName != NULL) {
-            for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
-                if (labelNames[i] != NULL && strcmp(labelName, labelNames[i]) == 0) {
-                    printf("Error: in file \"%s\" line %d: label name \"%s\" is not unique.\n", path, lineNumber, labelName);
-                    exit(1);
-                }
-            }
-
-            int labelNameLength = strlen(labelName);
-
-            if (labelNameLength > LABEL_NAME_MAX_LENGTH) {
-                printf("Error: in file \"%s\" line %d: label name must not be longer than %d characters.\n", path, lineNumber, LABEL_NAME_MAX_LENGTH);
-                exit(1);
-            }
-
-            labelNames[addressNumber] = malloc(labelNameLength + 1);
-            memcpy(labelNames[addressNumber], labelName, labelNameLength + 1);
-        }
-    }
-
-    fclose(file);
-
-    for (int i = 0; i < ADDRESS_SPACE_SIZE - 1; ++i) {
-        if (dataTypes[i] == DataTypeInstruction) {
-            dataTypes[i+1] = DataTypeNone;
-        }
-    }
-}
-
 static void handleSigInt(int _) {
-    if (isPaused) {
+    if (interruptibleDebugger->isPaused) {
         printf("\nQuitting.\n");
         exit(0);
     } else {
-        isPaused = true;
+        interruptibleDebugger->isPaused = true;
     }
 }
 
@@ -223,12 +193,25 @@ ua N  - updates register A value to N,\n\
 upc X - updates PC value to X,\n\
 b     - adds a breakpoint at PC,\n\
 b X   - adds a breakpoint at X,\n\
+b X if C - adds a breakpoint at X pausing only if condition C is true,\n\
 lb    - lists all breakpoints,\n\
 d     - deletes a breakpoint at PC,\n\
 d X   - deletes a breakpoint at X,\n\
 da    - deletes all breakpoints,\n\
+w X   - adds a watchpoint pausing after instructions writing to X,\n\
+w X:Y - adds watchpoints pausing after instructions writing to addresses from X to Y,\n\
+rw X  - adds a watchpoint pausing after instructions reading X,\n\
+rw X:Y - adds watchpoints pausing after instructions reading addresses from X to Y,\n\
+lw    - lists all watchpoints,\n\
+dw X  - deletes watchpoints at X,\n\
+dw X:Y - deletes watchpoints at addresses from X to Y,\n\
+dwa   - deletes all watchpoints,\n\
 c     - continues simulation,\n\
 s     - steps simulation (executes one instruction and pauses),\n\
+sb    - steps simulation back (undoes one instruction),\n\
+rc    - continues simulation backwards to the previous breakpoint,\n\
+save F - saves the machine, breakpoints, and symbols to snapshot file F,\n\
+load F - restores the machine, breakpoints, and symbols from snapshot file F,\n\
 q     - quits.\n\
 Replace X and Y with one of the following:\n\
 - a number - absolute address,\n\
@@ -237,7 +220,10 @@ Replace X and Y with one of the following:\n\
 - L+C or L-C where L is a label name and C is a number - address relative to a label.\n\
 Replace N with one of the following:\n\
 - a number between 0 and 255,\n\
-- a character in single quotes '.\n");
+- a character in single quotes '.\n\
+Replace C with a comparison (==, !=, <, <=, >, or >=) of two of the following: A, PC, M[X], a number, or a character in single quotes.\n\
+The last 16M instructions can be undone. Updating memory or registers, or loading a snapshot, clears this history.\n\
+Snapshots don't save conditions of breakpoints nor watchpoints.\n");
 }
 
 static const char* getInstructionName(unsigned char opcode, bool pad) {
@@ -255,37 +241,39 @@ static const char* getInstructionName(unsigned char opcode, bool pad) {
     return "";
 }
 
-static void printInstruction(struct MachineState* state, int address, bool padInstructionName) {
+static void printValue(struct Debugger* debugger, unsigned short address, unsigned char value) {
+    if (debugger->symbols.dataTypes[address] == DataTypeChar) {
+        printCharacterOrControlCharacter(value);
+    } else if (debugger->symbols.dataTypes[address] == DataTypeInt) {
+        printf("%d", value);
+    } else {
+        printf("0x%02X", value);
+    }
+}
+
+static void printInstruction(struct Debugger* debugger, struct MachineState* state, int address, bool padInstructionName) {
     unsigned short instruction = peekInstruction(state, address);
     unsigned char opcode = instruction >> 13;
     unsigned short argument = instruction & 0x1fff;
 
     printf("%s ", getInstructionName(opcode, padInstructionName));
 
-    if (labelNames[argument] == NULL) {
+    if (debugger->symbols.labelNames[argument] == NULL) {
         printf("0x%04X", argument);
     } else {
-        printf("%s", labelNames[argument]);
+        printf("%s", debugger->symbols.labelNames[argument]);
     }
 
     if (opcode < 4) {
-        if (labelNames[argument] == NULL) {
+        if (debugger->symbols.labelNames[argument] == NULL) {
             printf("    M[0x%04X] = ", argument);
-        } else if (strlen(labelNames[argument]) > 8) {
-            printf("    M[%c%c%c%c%c...] = ", labelNames[argument][0], labelNames[argument][1], labelNames[argument][2], labelNames[argument][3], labelNames[argument][4]);
+        } else if (strlen(debugger->symbols.labelNames[argument]) > 8) {
+            printf("    M[%c%c%c%c%c...] = ", debugger->symbols.labelNames[argument][0], debugger->symbols.labelNames[argument][1], debugger->symbols.labelNames[argument][2], debugger->symbols.labelNames[argument][3], debugger->symbols.labelNames[argument][4]);
         } else {
-            printf("    M[%s] = ", labelNames[argument]);
+            printf("    M[%s] = ", debugger->symbols.labelNames[argument]);
         }
 
-        unsigned char memoryValue = peekMemory(state, argument);
-
-        if (dataTypes[argument] == DataTypeChar) {
-            printCharacterOrControlCharacter(memoryValue);
-        } else if (dataTypes[argument] == DataTypeInt) {
-            printf("%d", memoryValue);
-        } else {
-            printf("0x%02X", memoryValue);
-        }
+        printValue(debugger, argument, peekMemory(state, argument));
     }
 }
 
@@ -309,7 +297,7 @@ static bool isFirstCharOfLabel(char ch) {
     return ch == '_' || ch >= 'a' && ch <= 'z' || ch >= 'A' && ch <= 'Z';
 }
 
-static int parseAddressArgument(struct MachineState* state, char* argument) {
+static int parseAddressArgument(struct Debugger* debugger, struct MachineState* state, char* argument) {
     if (argument == NULL) {
         return state->PC;
     }
@@ -322,7 +310,6 @@ static int parseAddressArgument(struct MachineState* state, char* argument) {
         }
         return validateAddress(state->PC + offset, argument);
     } else if (isFirstCharOfLabel(argument[0])) {
-        int baseAddress = -1;
         int offset = 0;
         char* offsetString = strpbrk(argument, "+-");
         char offsetStringFirstChar;
@@ -335,12 +322,7 @@ static int parseAddressArgument(struct MachineState* state, char* argument) {
             }
             offsetString[0] = 0;
         }
-        for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
-            if (labelNames[i] != NULL && strcmp(argument, labelNames[i]) == 0) {
-                baseAddress = i;
-                break;
-            }
-        }
+        int baseAddress = findLabel(&debugger->symbols, argument);
         if (baseAddress == -1) {
             printf("Label \"%s\" does not exist.\n", argument);
             return -1;
@@ -360,7 +342,7 @@ static int parseAddressArgument(struct MachineState* state, char* argument) {
     return 0;
 }
 
-static struct Range parseAddressRangeArgument(struct MachineState* state, char* argument) {
+static struct Range parseAddressRangeArgument(struct Debugger* debugger, struct MachineState* state, char* argument) {
     if (argument == NULL) {
         return (struct Range) { state->PC, state->PC };
     }
@@ -368,7 +350,7 @@ static struct Range parseAddressRangeArgument(struct MachineState* state, char*
     char* rangeDelimiter = strchr(argument, ':');
 
     if (rangeDelimiter == NULL) {
-        int address = parseAddressArgument(state, argument);
+        int address = parseAddressArgument(debugger, state, argument);
         return (struct Range) { address, address };
     }
 
@@ -381,12 +363,12 @@ static struct Range parseAddressRangeArgument(struct MachineState* state, char*
 
     *rangeDelimiter = 0;
 
-    int start = parseAddressArgument(state, argument);
+    int start = parseAddressArgument(debugger, state, argument);
     if (start < 0) {
         return (struct Range) { -1, -1 };
     }
 
-    int end = parseAddressArgument(state, rangeDelimiter + 1);
+    int end = parseAddressArgument(debugger, state, rangeDelimiter + 1);
     if (end < 0) {
         return (struct Range) { -1, -1 };
     }
@@ -412,25 +394,168 @@ static unsigned char parseValueArgument(char* argument) {
     }
 }
 
-static void printMemory(struct MachineState* state, unsigned short address, int maxLabelLength, bool printValueOfInstructionHigherBit) {
-    bool labelDefined = labelNames[address] != NULL;
+// Parses the operand at the beginning of the expression, and advances the expression past it. Prints an error and returns
+// false if the operand is invalid.
+static bool parseConditionOperand(struct Debugger* debugger, struct MachineState* state, char** expression, struct ConditionOperand* operand) {
+    char* start = *expression + strspn(*expression, " ");
+    char* end;
+
+    if (charUppercase(start[0]) == 'M' && start[1] == '[') {
+        end = strchr(start, ']');
+        end = end == NULL ? start + strlen(start) : end + 1;
+    } else if (start[0] == '\'') {
+        end = start[1] != 0 && start[2] == '\'' ? start + 3 : start + strlen(start);
+    } else {
+        end = start + strcspn(start, " =!<>");
+    }
+
+    char token[128] = {0};
+    memcpy(token, start, end - start);
+    int length = end - start;
+    *expression = end;
+
+    if (length == 0) {
+        printf("An operand of the condition is missing.\n");
+        return false;
+    } else if (stringsEqualCaseInsensitive(token, "A")) {
+        *operand = (struct ConditionOperand) { ConditionOperandA, 0 };
+    } else if (stringsEqualCaseInsensitive(token, "PC")) {
+        *operand = (struct ConditionOperand) { ConditionOperandPC, 0 };
+    } else if (charUppercase(token[0]) == 'M' && token[1] == '[') {
+        if (token[length - 1] != ']' || length == 3) {
+            printf("\"%s\" is not a valid memory operand.\n", token);
+            return false;
+        }
+        token[length - 1] = 0;
+        int address = parseAddressArgument(debugger, state, token + 2);
+        if (address < 0) return false;
+        *operand = (struct ConditionOperand) { ConditionOperandMemory, address };
+    } else if (token[0] == '\'') {
+        if (length != 3) {
+            printf("\"%s\" is not a valid character.\n", token);
+            return false;
+        }
+        *operand = (struct ConditionOperand) { ConditionOperandNumber, (unsigned char)token[1] };
+    } else if (isdigit(token[0])) {
+        int number = parseNumber(token, "number");
+        if (errno != 0) {
+            errno = 0;
+            return false;
+        }
+        if (number >= ADDRESS_SPACE_SIZE) {
+            printf("Number %d is out of range for a condition.\n", number);
+            return false;
+        }
+        *operand = (struct ConditionOperand) { ConditionOperandNumber, number };
+    } else {
+        printf("\"%s\" is not a valid operand. Use A, PC, M[X], a number, or a character.\n", token);
+        return false;
+    }
+
+    return true;
+}
+
+// Compiles the expression. Prints an error and returns NULL if it's invalid.
+static struct Condition* parseCondition(struct Debugger* debugger, struct MachineState* state, char* expression) {
+    expression += strspn(expression, " ");
+    expression[strcspn(expression, "\n")] = 0;
+
+    if (expression[0] == 0) {
+        printf("Condition was not provided.\n");
+        return NULL;
+    }
+
+    struct Condition condition = {0};
+    snprintf(condition.expression, sizeof(condition.expression), "%s", expression);
+
+    char* cursor = expression;
+    if (!parseConditionOperand(debugger, state, &cursor, &condition.left)) return NULL;
+
+    cursor += strspn(cursor, " ");
+    int operator = 0;
+    while (operator <= ComparisonGreater && strncmp(cursor, comparisonOperatorSymbols[operator], strlen(comparisonOperatorSymbols[operator])) != 0) {
+        ++operator;
+    }
+
+    if (operator > ComparisonGreater) {
+        printf("Condition \"%s\" doesn't compare with ==, !=, <, <=, >, or >=.\n", condition.expression);
+        return NULL;
+    }
+
+    condition.operator = operator;
+    cursor += strlen(comparisonOperatorSymbols[operator]);
+
+    if (!parseConditionOperand(debugger, state, &cursor, &condition.right)) return NULL;
+
+    if (cursor[strspn(cursor, " ")] != 0) {
+        printf("Condition \"%s\" has unexpected characters after the comparison.\n", condition.expression);
+        return NULL;
+    }
+
+    struct Condition* result = malloc(sizeof(struct Condition));
+    *result = condition;
+    return result;
+}
+
+static unsigned short getConditionOperandValue(struct MachineState* state, struct ConditionOperand operand) {
+    switch (operand.type) {
+        case ConditionOperandA: return state->A;
+        case ConditionOperandPC: return state->PC;
+        case ConditionOperandMemory: return peekMemory(state, operand.value);
+        default: return operand.value;
+    }
+}
+
+// Unconditional breakpoints have a NULL condition
+static bool isConditionMet(struct Condition* condition, struct MachineState* state) {
+    if (condition == NULL) return true;
+
+    unsigned short left = getConditionOperandValue(state, condition->left);
+    unsigned short right = getConditionOperandValue(state, condition->right);
+
+    switch (condition->operator) {
+        case ComparisonEqual: return left == right;
+        case ComparisonNotEqual: return left != right;
+        case ComparisonLessOrEqual: return left <= right;
+        case ComparisonGreaterOrEqual: return left >= right;
+        case ComparisonLess: return left < right;
+        case ComparisonGreater: return left > right;
+    }
+
+    return false;
+}
+
+// Returns the condition after an "if" word ending the command, or NULL if there's none
+static char* splitCondition(char* fullCommand) {
+    for (char* space = strchr(fullCommand, ' '); space != NULL; space = strchr(space + 1, ' ')) {
+        if (charUppercase(space[1]) == 'I' && charUppercase(space[2]) == 'F' && (space[3] == ' ' || space[3] == '\n' || space[3] == 0)) {
+            *space = 0;
+            return space + 3;
+        }
+    }
+
+    return NULL;
+}
+
+static void printMemory(struct Debugger* debugger, struct MachineState* state, unsigned short address, int maxLabelLength, bool printValueOfInstructionHigherBit) {
+    bool labelDefined = debugger->symbols.labelNames[address] != NULL;
 
     printf(
         "%s %s 0x%04X %*s%s ",
         state->PC == address ? "PC" : "  ",
-        breakpoints[address] ? "B" : " ",
+        debugger->breakpoints[address] ? "B" : " ",
         address,
         maxLabelLength,
-        labelDefined ? labelNames[address] : "",
+        labelDefined ? debugger->symbols.labelNames[address] : "",
         labelDefined ? ":" : " "
     );
 
     unsigned char memVal = peekMemory(state, address);
 
-    switch (dataTypes[address]) {
+    switch (debugger->symbols.dataTypes[address]) {
         case DataTypeNone:
-            if (address > 0 && dataTypes[address - 1] == DataTypeInstruction) {
-                if (printValueOfInstructionHigherBit || labelNames[address] != NULL) {
+            if (address > 0 && debugger->symbols.dataTypes[address - 1] == DataTypeInstruction) {
+                if (printValueOfInstructionHigherBit || debugger->symbols.labelNames[address] != NULL) {
                     printf("0x%02X (second byte of a %s instruction)", memVal, getInstructionName(memVal >> 5, false));
                 }
             } else {
@@ -438,7 +563,7 @@ static void printMemory(struct MachineState* state, unsigned short address, int
             }
             break;
         case DataTypeInstruction:
-            printInstruction(state, address, true);
+            printInstruction(debugger, state, address, true);
             break;
         case DataTypeChar:
             printCharacterOrControlCharacter(memVal);
@@ -451,28 +576,28 @@ static void printMemory(struct MachineState* state, unsigned short address, int
     printf("\n");
 }
 
-static void executeListMemoryCommand(struct MachineState* state, char* argument) {
-    struct Range addresses = parseAddressRangeArgument(state, argument);
+static void executeListMemoryCommand(struct Debugger* debugger, struct MachineState* state, char* argument) {
+    struct Range addresses = parseAddressRangeArgument(debugger, state, argument);
     if (addresses.start < 0) return;
 
     int longestLabelNameLength = 0;
     for (int i = addresses.start; i <= addresses.end; ++i) {
-        int labelNameLength = labelNames[i] != NULL ? strlen(labelNames[i]) : 0;
+        int labelNameLength = debugger->symbols.labelNames[i] != NULL ? strlen(debugger->symbols.labelNames[i]) : 0;
         longestLabelNameLength = longestLabelNameLength > labelNameLength ? longestLabelNameLength : labelNameLength;
     }
 
     for (int i = addresses.start; i <= addresses.end; ++i) {
-        printMemory(state, i, longestLabelNameLength, i == addresses.start);
+        printMemory(debugger, state, i, longestLabelNameLength, i == addresses.start);
     }
 }
 
-static void executeListBreakpointsCommand(struct MachineState* state) {
+static void executeListBreakpointsCommand(struct Debugger* debugger, struct MachineState* state) {
     int longestLabelNameLength = 0;
     bool anyBreakpointDefined = false;
     for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
-        if (breakpoints[i]) {
+        if (debugger->breakpoints[i]) {
             anyBreakpointDefined = true;
-            int labelNameLength = labelNames[i] != NULL ? strlen(labelNames[i]) : 0;
+            int labelNameLength = debugger->symbols.labelNames[i] != NULL ? strlen(debugger->symbols.labelNames[i]) : 0;
             longestLabelNameLength = longestLabelNameLength > labelNameLength ? longestLabelNameLength : labelNameLength;
         }
     }
@@ -483,8 +608,11 @@ static void executeListBreakpointsCommand(struct MachineState* state) {
     }
 
     for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
-        if (breakpoints[i]) {
-            printMemory(state, i, longestLabelNameLength, true);
+        if (debugger->breakpoints[i]) {
+            printMemory(debugger, state, i, longestLabelNameLength, true);
+            if (debugger->conditions[i] != NULL) {
+                printf("         if %s\n", debugger->conditions[i]->expression);
+            }
         }
     }
     if (!anyBreakpointDefined) {
@@ -492,11 +620,11 @@ static void executeListBreakpointsCommand(struct MachineState* state) {
     }
 }
 
-static void executeListLabelsCommand() {
+static void executeListLabelsCommand(struct Debugger* debugger) {
     bool anyLabelDefined = false;
     for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
-        if (labelNames[i] != NULL) {
-            printf("0x%04X %s\n", i, labelNames[i]);
+        if (debugger->symbols.labelNames[i] != NULL) {
+            printf("0x%04X %s\n", i, debugger->symbols.labelNames[i]);
             anyLabelDefined = true;
         }
     }
@@ -505,7 +633,7 @@ static void executeListLabelsCommand() {
     }
 }
 
-static void executeListRegistersCommand(struct MachineState* state) {
+static void executeListRegistersCommand(struct Debugger* debugger, struct MachineState* state) {
     printf("A = 0x%02X %d", state->A, state->A);
 
     if (state->A <= 127) {
@@ -514,19 +642,19 @@ static void executeListRegistersCommand(struct MachineState* state) {
     }
 
     printf("    PC = 0x%04X", state->PC);
-    if (labelNames[state->PC] != NULL) {
-        printf(" %s", labelNames[state->PC]);
+    if (debugger->symbols.labelNames[state->PC] != NULL) {
+        printf(" %s", debugger->symbols.labelNames[state->PC]);
     }
 
     printf("    instruction = ");
 
-    printInstruction(state, state->PC, false);
+    printInstruction(debugger, state, state->PC, false);
 
     printf("\n");
 }
 
-static void executeUpdateMemoryCommand(struct MachineState* state, char* addressArgument, char* valueArgument) {
-    int address = parseAddressArgument(state, addressArgument);
+static void executeUpdateMemoryCommand(struct Debugger* debugger, struct MachineState* state, char* addressArgument, char* valueArgument) {
+    int address = parseAddressArgument(debugger, state, addressArgument);
     if (address < 0) {
         return;
     } else if (address >= TIME_INTERFACE_ADDRESS) {
@@ -540,7 +668,8 @@ static void executeUpdateMemoryCommand(struct MachineState* state, char* address
         return;
     }
 
-    state->memory[address] = value;
+    setMemory(state, address, value);
+    resetHistory(state->history, state);
     printf("Updated memory at to 0x%04X to 0x%02X.\n", address, value);
 }
 
@@ -552,52 +681,80 @@ static void executeUpdateACommand(struct MachineState* state, char* argument) {
     }
 
     state->A = value;
+    resetHistory(state->history, state);
     printf("Updated A value to 0x%02X.\n", value);
 }
 
-static void executeUpdatePCCommand(struct MachineState* state, char* argument) {
-    int address = parseAddressArgument(state, argument);
+static void executeUpdatePCCommand(struct Debugger* debugger, struct MachineState* state, char* argument) {
+    int address = parseAddressArgument(debugger, state, argument);
     if (address < 0) {
         return;
     }
 
     state->PC = address;
+    resetHistory(state->history, state);
     printf("Updated PC to 0x%04X.\n", address);
 }
 
-static void executeAddBreakpointCommand(struct MachineState* state, char* argument) {
-    int address = parseAddressArgument(state, argument);
+static void executeAddBreakpointCommand(struct Debugger* debugger, struct MachineState* state, char* argument, char* conditionExpression) {
+    int address = parseAddressArgument(debugger, state, argument);
     if (address < 0) return;
-    
-    if (breakpoints[address]) {
+
+    struct Condition* condition = NULL;
+    if (conditionExpression != NULL) {
+        condition = parseCondition(debugger, state, conditionExpression);
+        if (condition == NULL) return;
+    }
+
+    if (!debugger->breakpoints[address]) {
+        debugger->breakpoints[address] = true;
+        debugger->isBlockMapValid = false;
+        debugger->conditions[address] = condition;
+        printf("Added a breakpoint at 0x%04X", address);
+    } else if (condition == NULL && debugger->conditions[address] == NULL) {
         printf("Breakpoint at 0x%04X was already added.\n", address);
+        return;
     } else {
-        breakpoints[address] = true;
-        printf("Added a breakpoint at 0x%04X.\n", address);
+        free(debugger->conditions[address]);
+        debugger->conditions[address] = condition;
+        printf("Updated the breakpoint at 0x%04X to pause%s", address, condition == NULL ? " unconditionally" : "");
+    }
+
+    if (condition != NULL) {
+        printf(" if %s", condition->expression);
     }
+
+    printf(".\n");
 }
 
-static void executeDeleteBreakpointCommand(struct MachineState* state, char* argument) {
-    int address = parseAddressArgument(state, argument);
+static void executeDeleteBreakpointCommand(struct Debugger* debugger, struct MachineState* state, char* argument) {
+    int address = parseAddressArgument(debugger, state, argument);
     if (address < 0) return;
     
-    if (breakpoints[address]) {
-        breakpoints[address] = false;
+    if (debugger->breakpoints[address]) {
+        debugger->breakpoints[address] = false;
+        debugger->isBlockMapValid = false;
+        free(debugger->conditions[address]);
+        debugger->conditions[address] = NULL;
         printf("Deleted a breakpoint at 0x%04X.\n", address);
     } else {
         printf("There isn't a breakpoint at 0x%04X.\n", address);
     }
 }
 
-static void executeDeleteAllBreakpointsCommand() {
+static void executeDeleteAllBreakpointsCommand(struct Debugger* debugger) {
     int breakpointsDeleted = 0;
     for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
-        if (breakpoints[i]) {
+        if (debugger->breakpoints[i]) {
             ++breakpointsDeleted;
-            breakpoints[i] = false;
+            debugger->breakpoints[i] = false;
+            free(debugger->conditions[i]);
+            debugger->conditions[i] = NULL;
         }
     }
 
+    debugger->isBlockMapValid = false;
+
     if (breakpointsDeleted == 0) {
         printf("There aren't any breakpoints.\n");
     } else {
@@ -605,6 +762,157 @@ static void executeDeleteAllBreakpointsCommand() {
     }
 }
 
+static const char* getWatchpointTypeName(unsigned char type) {
+    switch (type) {
+        case WatchpointRead: return "read";
+        case WatchpointWrite: return "write";
+        default: return "read and write";
+    }
+}
+
+static void executeAddWatchpointCommand(struct Debugger* debugger, struct MachineState* state, char* argument, enum WatchpointType type) {
+    if (argument == NULL) {
+        printf("Watched address was not provided.\n");
+        return;
+    }
+
+    struct Range addresses = parseAddressRangeArgument(debugger, state, argument);
+    if (addresses.start < 0) return;
+
+    for (int i = addresses.start; i <= addresses.end; ++i) {
+        if (debugger->watchpoints[i] == 0) ++debugger->watchpointCount;
+        debugger->watchpoints[i] |= type;
+    }
+
+    if (addresses.start == addresses.end) {
+        printf("Added a %s watchpoint at 0x%04X.\n", getWatchpointTypeName(type), addresses.start);
+    } else {
+        printf("Added %s watchpoints at 0x%04X:0x%04X.\n", getWatchpointTypeName(type), addresses.start, addresses.end);
+    }
+}
+
+static void executeListWatchpointsCommand(struct Debugger* debugger) {
+    if (debugger->watchpointCount == 0) {
+        printf("No watchpoints added.\n");
+        return;
+    }
+
+    for (int start = 0, end; start < ADDRESS_SPACE_SIZE; start = end + 1) {
+        for (end = start; end + 1 < ADDRESS_SPACE_SIZE && debugger->watchpoints[end + 1] == debugger->watchpoints[start]; ++end);
+
+        if (debugger->watchpoints[start] == 0) continue;
+
+        if (start == end) {
+            printf("0x%04X      ", start);
+        } else {
+            printf("0x%04X:0x%04X", start, end);
+        }
+
+        printf(" %-14s", getWatchpointTypeName(debugger->watchpoints[start]));
+
+        if (debugger->symbols.labelNames[start] != NULL) {
+            printf(" %s", debugger->symbols.labelNames[start]);
+        }
+
+        printf("\n");
+    }
+}
+
+static void executeDeleteWatchpointsCommand(struct Debugger* debugger, struct MachineState* state, char* argument) {
+    if (argument == NULL) {
+        printf("Watched address was not provided.\n");
+        return;
+    }
+
+    struct Range addresses = parseAddressRangeArgument(debugger, state, argument);
+    if (addresses.start < 0) return;
+
+    int watchpointsDeleted = 0;
+    for (int i = addresses.start; i <= addresses.end; ++i) {
+        if (debugger->watchpoints[i] != 0) {
+            ++watchpointsDeleted;
+            debugger->watchpoints[i] = 0;
+        }
+    }
+
+    debugger->watchpointCount -= watchpointsDeleted;
+
+    if (watchpointsDeleted == 0) {
+        printf("There aren't any watchpoints at 0x%04X:0x%04X.\n", addresses.start, addresses.end);
+    } else {
+        printf("%d watchpoints deleted.\n", watchpointsDeleted);
+    }
+}
+
+static void executeDeleteAllWatchpointsCommand(struct Debugger* debugger) {
+    if (debugger->watchpointCount == 0) {
+        printf("There aren't any watchpoints.\n");
+    } else {
+        printf("%d watchpoints deleted.\n", debugger->watchpointCount);
+    }
+
+    memset(debugger->watchpoints, 0, ADDRESS_SPACE_SIZE);
+    debugger->watchpointCount = 0;
+}
+
+static void executeSaveSnapshotCommand(struct Debugger* debugger, struct MachineState* state, char* argument) {
+    if (argument == NULL) {
+        printf("Snapshot file path was not provided.\n");
+        return;
+    }
+
+    if (saveSnapshot(argument, state, debugger->breakpoints, &debugger->symbols)) {
+        printf("Saved a snapshot to \"%s\".\n", argument);
+    }
+}
+
+static void executeLoadSnapshotCommand(struct Debugger* debugger, struct MachineState* state, char* argument) {
+    if (argument == NULL) {
+        printf("Snapshot file path was not provided.\n");
+        return;
+    }
+
+    bool previousBreakpoints[ADDRESS_SPACE_SIZE];
+    memcpy(previousBreakpoints, debugger->breakpoints, ADDRESS_SPACE_SIZE);
+
+    if (loadSnapshot(argument, state, debugger->breakpoints, &debugger->symbols)) {
+        // Conditions aren't saved, so they're kept only if the snapshot has no breakpoints
+        if (memcmp(previousBreakpoints, debugger->breakpoints, ADDRESS_SPACE_SIZE) != 0) {
+            for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
+                free(debugger->conditions[i]);
+                debugger->conditions[i] = NULL;
+            }
+        }
+
+        debugger->pauseStartTimeMs = getTimeMs();
+        debugger->isBlockMapValid = false;
+        resetHistory(state->history, state);
+        printf("Loaded a snapshot from \"%s\".\n", argument);
+        executeListRegistersCommand(debugger, state);
+    }
+}
+
+static void executeStepBackCommand(struct Debugger* debugger, struct MachineState* state) {
+    if (stepBack(state->history, state)) {
+        executeListRegistersCommand(debugger, state);
+    } else {
+        printf("Reached the beginning of the execution history.\n");
+    }
+}
+
+static void executeReverseContinueCommand(struct Debugger* debugger, struct MachineState* state) {
+    bool isBreakpointFound;
+    do {
+        isBreakpointFound = reverseContinue(state->history, state, debugger->breakpoints);
+    } while (isBreakpointFound && !isConditionMet(debugger->conditions[state->PC], state));
+
+    if (!isBreakpointFound) {
+        printf("There isn't a breakpoint in the execution history. Reached its beginning.\n");
+    }
+
+    executeListRegistersCommand(debugger, state);
+}
+
 static enum Command getCommand(char* commandName) {
     if (stringsEqualCaseInsensitive(commandName, "H")) {
         return CommandHelp;
@@ -632,6 +940,24 @@ static enum Command getCommand(char* commandName) {
         return CommandContinue;
     } else if (stringsEqualCaseInsensitive(commandName, "S")) {
         return CommandStep;
+    } else if (stringsEqualCaseInsensitive(commandName, "W")) {
+        return CommandAddWriteWatchpoint;
+    } else if (stringsEqualCaseInsensitive(commandName, "RW")) {
+        return CommandAddReadWatchpoint;
+    } else if (stringsEqualCaseInsensitive(commandName, "LW")) {
+        return CommandListWatchpoints;
+    } else if (stringsEqualCaseInsensitive(commandName, "DW")) {
+        return CommandDeleteWatchpoints;
+    } else if (stringsEqualCaseInsensitive(commandName, "DWA")) {
+        return CommandDeleteAllWatchpoints;
+    } else if (stringsEqualCaseInsensitive(commandName, "SB")) {
+        return CommandStepBack;
+    } else if (stringsEqualCaseInsensitive(commandName, "RC")) {
+        return CommandReverseContinue;
+    } else if (stringsEqualCaseInsensitive(commandName, "SAVE")) {
+        return CommandSaveSnapshot;
+    } else if (stringsEqualCaseInsensitive(commandName, "LOAD")) {
+        return CommandLoadSnapshot;
     } else if (stringsEqualCaseInsensitive(commandName, "Q")) {
         return CommandQuit;
     } else {
@@ -640,7 +966,8 @@ static enum Command getCommand(char* commandName) {
 }
 
 // Returns true if prompt interaction should continue, or false if simulation should resume
-static bool executeCommand(struct MachineState* state, char* fullCommand) {
+static bool executeCommand(struct Debugger* debugger, struct MachineState* state, char* fullCommand) {
+    char* condition = splitCondition(fullCommand);
     char* commandName = strtok(fullCommand, " \n");
     char* arg1 = strtok(NULL, " \n");
     char* arg2 = strtok(NULL, " \n");
@@ -657,6 +984,11 @@ static bool executeCommand(struct MachineState* state, char* fullCommand) {
         return true;
     }
 
+    if (condition != NULL && command != CommandAddBreakpoint) {
+        printf("Command \"%s\" doesn't take a condition. Type \"h\" to list all commands.\n", commandName);
+        return true;
+    }
+
     switch (command) {
         case CommandUpdateMemory:
             if (extra != NULL) {
@@ -669,6 +1001,11 @@ static bool executeCommand(struct MachineState* state, char* fullCommand) {
         case CommandUpdatePC:
         case CommandAddBreakpoint:
         case CommandDeleteBreakpoint:
+        case CommandAddWriteWatchpoint:
+        case CommandAddReadWatchpoint:
+        case CommandDeleteWatchpoints:
+        case CommandSaveSnapshot:
+        case CommandLoadSnapshot:
             if (arg2 != NULL) {
                 printf("Command \"%s\" doesn't take more than one argument. Type \"h\" to list all commands.\n", commandName);
                 return true;
@@ -686,30 +1023,48 @@ static bool executeCommand(struct MachineState* state, char* fullCommand) {
         case CommandHelp:
             executeHelpCommand(); break;
         case CommandListMemory:
-            executeListMemoryCommand(state, arg1); break;
+            executeListMemoryCommand(debugger, state, arg1); break;
         case CommandListBreakpoints:
-            executeListBreakpointsCommand(state); break;
+            executeListBreakpointsCommand(debugger, state); break;
         case CommandListLabels:
-            executeListLabelsCommand(); break;
+            executeListLabelsCommand(debugger); break;
         case CommandListRegisters:
-            executeListRegistersCommand(state); break; 
+            executeListRegistersCommand(debugger, state); break; 
         case CommandUpdateMemory:
-            executeUpdateMemoryCommand(state, arg1, arg2); break; 
+            executeUpdateMemoryCommand(debugger, state, arg1, arg2); break; 
         case CommandUpdateA:
             executeUpdateACommand(state, arg1); break; 
         case CommandUpdatePC:
-            executeUpdatePCCommand(state, arg1); break; 
+            executeUpdatePCCommand(debugger, state, arg1); break; 
         case CommandAddBreakpoint:
-            executeAddBreakpointCommand(state, arg1); break;
+            executeAddBreakpointCommand(debugger, state, arg1, condition); break;
         case CommandDeleteBreakpoint:
-            executeDeleteBreakpointCommand(state, arg1); break;
+            executeDeleteBreakpointCommand(debugger, state, arg1); break;
         case CommandDeleteAllBreakpoints:
-            executeDeleteAllBreakpointsCommand(); break;
+            executeDeleteAllBreakpointsCommand(debugger); break;
+        case CommandAddWriteWatchpoint:
+            executeAddWatchpointCommand(debugger, state, arg1, WatchpointWrite); break;
+        case CommandAddReadWatchpoint:
+            executeAddWatchpointCommand(debugger, state, arg1, WatchpointRead); break;
+        case CommandListWatchpoints:
+            executeListWatchpointsCommand(debugger); break;
+        case CommandDeleteWatchpoints:
+            executeDeleteWatchpointsCommand(debugger, state, arg1); break;
+        case CommandDeleteAllWatchpoints:
+            executeDeleteAllWatchpointsCommand(debugger); break;
+        case CommandSaveSnapshot:
+            executeSaveSnapshotCommand(debugger, state, arg1); break;
+        case CommandLoadSnapshot:
+            executeLoadSnapshotCommand(debugger, state, arg1); break;
         case CommandContinue:
             return false;
         case CommandStep:
-            isStepping = true;
+            debugger->isStepping = true;
             return false;
+        case CommandStepBack:
+            executeStepBackCommand(debugger, state); break;
+        case CommandReverseContinue:
+            executeReverseContinueCommand(debugger, state); break;
         case CommandQuit:
             printf("Quitting.\n");
             exit(0);
@@ -719,43 +1074,149 @@ static bool executeCommand(struct MachineState* state, char* fullCommand) {
     return true;
 }
 
-static void interactivePrompt(struct MachineState* state) {
+static void printWatchpointHit(struct Debugger* debugger, struct MachineState* state) {
+    struct WatchpointHit* hit = &debugger->watchpointHit;
+
+    printf("Watchpoint at 0x%04X", hit->address);
+    if (debugger->symbols.labelNames[hit->address] != NULL) {
+        printf(" %s", debugger->symbols.labelNames[hit->address]);
+    }
+
+    printf(": instruction at 0x%04X %s", hit->instructionAddress, hit->type == WatchpointWrite ? "wrote " : "read");
+
+    // Values of memory-mapped registers can't be read again without side effects
+    if (hit->type == WatchpointWrite) {
+        printValue(debugger, hit->address, state->A);
+        if (hit->address < TIME_INTERFACE_ADDRESS) {
+            printf(" (was ");
+            printValue(debugger, hit->address, hit->previousValue);
+            printf(")");
+        }
+    } else if (hit->address < TIME_INTERFACE_ADDRESS) {
+        printf(" ");
+        printValue(debugger, hit->address, hit->previousValue);
+    }
+
+    printf(".\n");
+}
+
+// Has the same semantics as stepWithHistory(), and pauses the debugger after the instruction if it accessed a watched address
+static int stepWithWatchpoints(struct Debugger* debugger, struct MachineState* state) {
+    unsigned short PC = state->PC;
+
+    // Instructions fetched from memory-mapped registers can't be decoded in advance, so they aren't checked
+    if (PC >= TIME_INTERFACE_ADDRESS - 1) return stepWithHistory(state->history, state);
+
+    struct DecodedInstruction decoded = getDecodedInstruction(state, PC);
+    enum WatchpointType type = decoded.opcode < 4 ? WatchpointRead : WatchpointWrite;
+
+    if (decoded.opcode > 4 || (debugger->watchpoints[decoded.argument] & type) == 0) {
+        return stepWithHistory(state->history, state);
+    }
+
+    unsigned char previousValue = peekMemory(state, decoded.argument);
+    int cycles = stepWithHistory(state->history, state);
+
+    debugger->watchpointHit = (struct WatchpointHit) { true, type, decoded.argument, PC, previousValue };
+    debugger->isPaused = true;
+
+    return cycles;
+}
+
+// Splits the memory into straight-line blocks ending before breakpoints, so running a block doesn't skip any
+static void updateBlockMap(struct Debugger* debugger) {
+    for (int address = ADDRESS_SPACE_SIZE - 1; address >= 0; --address) {
+        int nextAddress = address + 2;
+        bool endsBlock = nextAddress >= ADDRESS_SPACE_SIZE || debugger->breakpoints[nextAddress];
+        debugger->blockLengths[address] = endsBlock ? 1 : debugger->blockLengths[nextAddress] + 1;
+    }
+
+    debugger->isBlockMapValid = true;
+}
+
+static void interactivePrompt(struct Debugger* debugger, struct MachineState* state) {
     printf("Paused.   ");
-    executeListRegistersCommand(state);
+    executeListRegistersCommand(debugger, state);
     bool interactive = true;
     char fullCommand[128] = {0};
     while (interactive) {
         printf("> ");
         fgets(fullCommand, 127, stdin);
-        interactive = executeCommand(state, fullCommand);
+        interactive = executeCommand(debugger, state, fullCommand);
     }
 }
 
-void runDebug(struct MachineState* state, char* symbolsFilePath) {
-    parseSymbolsFile(symbolsFilePath);
+void runDebug(struct MachineState* state, char* symbolsFilePath, const char* snapshotFilePath) {
+    struct Debugger* debugger = calloc(1, sizeof(struct Debugger));
+    debugger->isPaused = true;
+    debugger->symbols.dataTypes[IO_INTERFACE_ADDRESS] = DataTypeChar;
+
+    parseSymbolsFile(&debugger->symbols, symbolsFilePath);
+
+    if (snapshotFilePath != NULL && !loadSnapshot(snapshotFilePath, state, debugger->breakpoints, symbolsFilePath == NULL ? &debugger->symbols : NULL)) {
+        exit(1);
+    }
+
+    state->history = createHistory(state);
 
     printf("Starting in debug mode. Type \"h\" to list all commands or \"c\" to begin simulation. Press ^C during simulation to pause.\n");
 
+    interruptibleDebugger = debugger;
     signal(SIGINT, handleSigInt);
 
-    startAsyncCharacterInput();
+    struct ClockPacer pacer = getClockPacer(state->isTimeVirtual ? UNLIMITED_CLOCK_FREQUENCY : state->clockFrequencyKiloHz);
+    unsigned long cycles = 0;
+
+    startAsyncCharacterInput(state->keyboardInput);
 
     do {
-        if (isPaused || isStepping || breakpoints[state->PC]) {
-            isPaused = true;
-            isStepping = false;
-            unsigned long idleStartTime = getTimeMs();
-            endAsyncCharacterInput();
-            interactivePrompt(state);
-            startAsyncCharacterInput();
-            state->simulationIdleTimeMs += getTimeMs() - idleStartTime;
-            isPaused = false;
+        if (debugger->isPaused || debugger->isStepping || (debugger->breakpoints[state->PC] && isConditionMet(debugger->conditions[state->PC], state))) {
+            debugger->isPaused = true;
+            debugger->isStepping = false;
+            flushOutput(state->terminalOutput);
+            debugger->pauseStartTimeMs = getTimeMs();
+            endAsyncCharacterInput(state->keyboardInput);
+            if (debugger->watchpointHit.isPending) {
+                printWatchpointHit(debugger, state);
+                debugger->watchpointHit.isPending = false;
+            }
+            interactivePrompt(debugger, state);
+            startAsyncCharacterInput(state->keyboardInput);
+            state->simulationIdleTimeMs += getTimeMs() - debugger->pauseStartTimeMs;
+            debugger->isPaused = false;
+            resetClockPacer(&pacer);
+            cycles = 0;
         }
         
-        step(state);
-    } while (!state->isUnconditionalInfiniteLoop);
+        // Breakpoints and ^C are checked once per block, instructions are only checked with watchpoints
+        if (debugger->watchpointCount != 0) {
+            cycles += stepWithWatchpoints(debugger, state);
+        } else if (debugger->isStepping) {
+            cycles += stepWithHistory(state->history, state);
+        } else {
+            if (!debugger->isBlockMapValid) updateBlockMap(debugger);
+            cycles += runBlocksWithHistory(state->history, state, debugger->blockLengths, debugger->breakpoints, &debugger->isPaused, pacer.batchCycles);
+        }
+
+        if (cycles >= pacer.batchCycles) {
+            flushIdleOutput(state->terminalOutput);
+            paceClock(&pacer, cycles);
+            cycles = 0;
+        }
+    } while (state->haltReason == HaltReasonNone);
 
-    endAsyncCharacterInput();
+    flushOutput(state->terminalOutput);
+
+    endAsyncCharacterInput(state->keyboardInput);
 
     printf("Unconditional infinite loop detected. Ending simulation.\n");
+
+    signal(SIGINT, SIG_DFL);
+    interruptibleDebugger = NULL;
+
+    destroyHistory(state->history);
+    state->history = NULL;
+    for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) free(debugger->conditions[i]);
+    freeSymbols(&debugger->symbols);
+    free(debugger);
 }
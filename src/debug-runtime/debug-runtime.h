@@ -3,6 +3,7 @@
 
 #include "../machine-state/machine-state.h"
 
-void runDebug(struct MachineState* state, char* symbolsFilePath);
+// Loads the snapshot with its breakpoints and symbols unless the path is NULL. Symbols from the file replace the ones of the snapshot.
+void runDebug(struct MachineState* state, char* symbolsFilePath, const char* snapshotFilePath);
 
 #endif
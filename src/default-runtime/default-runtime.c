@@ -1,13 +1,61 @@
 #include "default-runtime.h"
 #include "../machine-state/machine-state.h"
+#include "../engine/engine.h"
 #include "../keyboard-input/keyboard-input.h"
+#include "../clock-pacer/clock-pacer.h"
+#include "../terminal-output/terminal-output.h"
+#include "../time/time.h"
+#include "../idle-loop/idle-loop.h"
+#include "../non-termination/non-termination.h"
+#include <stdlib.h>
 
-void runDefault(struct MachineState* state) {
-    startAsyncCharacterInput();
+void runDefault(struct MachineState* state, struct Engine* engine, FILE* inputFile, unsigned long long maxCycles, unsigned long maxTimeMs, bool detectsNonTermination) {
+    struct ClockPacer pacer = getClockPacer(state->isTimeVirtual ? UNLIMITED_CLOCK_FREQUENCY : state->clockFrequencyKiloHz);
+    unsigned long long startTimeNs = getTimeNs();
+    struct NonTerminationDetector* nonTerminationDetector = NULL;
+
+    if (detectsNonTermination) {
+        nonTerminationDetector = malloc(sizeof(struct NonTerminationDetector));
+        *nonTerminationDetector = getNonTerminationDetector();
+    }
+
+    if (inputFile != NULL) {
+        startFileCharacterInput(state->keyboardInput, inputFile);
+    } else {
+        startAsyncCharacterInput(state->keyboardInput);
+    }
 
     do {
-        step(state);
-    } while (!state->isUnconditionalInfiniteLoop);
+        unsigned long cycleBudget = pacer.batchCycles;
+        if (maxCycles != 0 && maxCycles - state->cycleCount < cycleBudget) {
+            cycleBudget = maxCycles - state->cycleCount;
+        }
+
+        unsigned long cycles = engine->run(state, engine->context, cycleBudget);
+        flushIdleOutput(state->terminalOutput);
+
+        if (state->haltReason != HaltReasonNone) break;
+
+        if (maxCycles != 0 && state->cycleCount >= maxCycles) {
+            state->haltReason = HaltReasonCycleLimit;
+        } else if (maxTimeMs != 0 && getTimeNs() - startTimeNs >= maxTimeMs * 1000000ULL) {
+            state->haltReason = HaltReasonTimeLimit;
+        } else if (nonTerminationDetector != NULL && detectNonTermination(nonTerminationDetector, state, cycles)) {
+            state->haltReason = HaltReasonNonTermination;
+        } else {
+            paceClock(&pacer, cycles);
+
+            // Skipped iterations would be missing from the trace
+            if (state->traceWriter == NULL) {
+                struct IdleLoop idleLoop = findIdleLoop(state);
+                if (idleLoop.cycles != 0) paceClock(&pacer, skipIdleLoop(state, idleLoop, maxCycles));
+            }
+        }
+    } while (state->haltReason == HaltReasonNone);
+
+    flushOutput(state->terminalOutput);
+
+    if (inputFile == NULL) endAsyncCharacterInput(state->keyboardInput);
 
-    endAsyncCharacterInput();
+    free(nonTerminationDetector);
 }
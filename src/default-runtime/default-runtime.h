@@ -2,7 +2,11 @@
 #define default_runtime
 
 #include "../machine-state/machine-state.h"
+#include "../engine/engine.h"
+#include <stdio.h>
 
-void runDefault(struct MachineState* state);
+// Runs the machine with the engine, reading input from inputFile, or from the terminal if it's NULL. A maxCycles or
+// maxTimeMs of 0 means no limit.
+void runDefault(struct MachineState* state, struct Engine* engine, FILE* inputFile, unsigned long long maxCycles, unsigned long maxTimeMs, bool detectsNonTermination);
 
 #endif
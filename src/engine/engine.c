@@ -0,0 +1,65 @@
+#include "engine.h"
+#include "../machine-state/machine-state.h"
+#include "../threaded-engine/threaded-engine.h"
+#include "../jit-engine/jit-engine.h"
+#include "../profiler/profiler.h"
+#include "../call-graph/call-graph.h"
+#include "../cycle-engine/cycle-engine.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Counts instructions in a local variable, which costs much less than an instruction
+static unsigned long runSwitch(struct MachineState* state, void* instructionCount, unsigned long cycleBudget) {
+    unsigned long cycles = 0;
+    unsigned long instructions = 0;
+
+    do {
+        cycles += step(state);
+        ++instructions;
+    } while (cycles < cycleBudget && state->haltReason == HaltReasonNone);
+
+    *(unsigned long long*) instructionCount += instructions;
+    return cycles;
+}
+
+struct Engine createEngine(enum EngineType type) {
+    switch (type) {
+        case EngineTypeThreaded:
+            return (struct Engine) { runThreaded, NULL };
+        case EngineTypeJit:
+            void* jit = createJit();
+            if (jit != NULL) return (struct Engine) { runJit, jit };
+            fprintf(stderr, "Warning: the JIT engine is not available on this host, using the threaded engine instead.\n");
+            return (struct Engine) { runThreaded, NULL };
+        case EngineTypeProfiling:
+            return (struct Engine) { runThreaded, calloc(1, sizeof(struct Profile)) };
+        case EngineTypeCycle:
+            return (struct Engine) { runCycleAccurate, createCycleEngine(NULL, false) };
+        default:
+            return (struct Engine) { runSwitch, calloc(1, sizeof(unsigned long long)) };
+    }
+}
+
+unsigned long long getEngineInstructionCount(struct Engine* engine) {
+    if (engine->run == runSwitch) return *(unsigned long long*) engine->context;
+    if (engine->run == runThreaded && engine->context != NULL) return countProfiledInstructions(engine->context);
+    if (engine->run == runCycleAccurate) return ((struct CycleEngine*) engine->context)->instructionCount;
+    if (engine->run == runCallGraph) return countProfiledInstructions(&((struct CallGraph*) engine->context)->profile);
+    return 0;
+}
+
+void destroyEngine(struct Engine* engine) {
+    if (engine->run == runJit) {
+        destroyJit(engine->context);
+    } else if (engine->run == runThreaded || engine->run == runSwitch) {
+        free(engine->context); // the profile if profiling, or the instruction count
+    } else if (engine->run == runCallGraph) {
+        destroyCallGraph(engine->context);
+    } else if (engine->run == runCycleAccurate) {
+        destroyCycleEngine(engine->context);
+    }
+
+    engine->run = NULL;
+    engine->context = NULL;
+}
@@ -0,0 +1,30 @@
+#ifndef engine_h
+#define engine_h
+
+#include "../machine-state/machine-state.h"
+
+enum EngineType {
+    EngineTypeSwitch = 0,
+    EngineTypeThreaded,
+    EngineTypeJit,
+    EngineTypeProfiling, // the threaded engine counting instructions in a struct Profile context
+    EngineTypeCycle // the cycle-accurate engine with a struct CycleEngine context
+};
+
+// Executes instructions until at least cycleBudget clock cycles elapse or the simulation ends, and returns the number of elapsed clock cycles
+typedef unsigned long (*EngineRunner)(struct MachineState* state, void* context, unsigned long cycleBudget);
+
+struct Engine {
+    EngineRunner run;
+    void* context;
+};
+
+struct Engine createEngine(enum EngineType type);
+
+// Returns the number of instructions executed by the switch engine, the cycle-accurate engine, the profiling engine, or the
+// call graph profiler, or 0 if the engine doesn't count them
+unsigned long long getEngineInstructionCount(struct Engine* engine);
+
+void destroyEngine(struct Engine* engine);
+
+#endif
@@ -0,0 +1,242 @@
+#include "fleet-runtime.h"
+#include "../machine-state/machine-state.h"
+#include "../default-runtime/default-runtime.h"
+#include "../keyboard-input/keyboard-input.h"
+#include "../terminal-output/terminal-output.h"
+#include "../time/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h> // POSIX
+#include <unistd.h> // POSIX
+
+struct Job {
+    char* binaryFilePath;
+    char* inputFilePath; // NULL if the program gets no input
+    char* outputFilePath;
+    bool failed;
+    enum HaltReason haltReason;
+    unsigned long long cycleCount;
+    unsigned long long wallTimeNs;
+};
+
+// Runs its own range of jobs, then steals jobs from the ranges of other workers
+struct Worker {
+    struct Fleet* fleet;
+    pthread_t thread;
+    atomic_int nextJob;
+    int endJob;
+};
+
+struct Fleet {
+    struct Job* jobs;
+    int jobCount;
+    struct Worker* workers;
+    int workerCount;
+    enum EngineType engineType;
+    int clockFrequencyKiloHz;
+    bool isTimeVirtual;
+    unsigned long long maxCycles;
+    unsigned long maxTimeMs;
+    bool detectsNonTermination;
+};
+
+static const char* getHaltReasonName(struct Job* job) {
+    if (job->failed) return "failed";
+
+    switch (job->haltReason) {
+        case HaltReasonInfiniteLoop: return "infinite loop";
+        case HaltReasonEndOfInput: return "end of input";
+        case HaltReasonCycleLimit: return "cycle limit";
+        case HaltReasonTimeLimit: return "time limit";
+        case HaltReasonNonTermination: return "non-termination";
+        default: return "";
+    }
+}
+
+static char* copyString(const char* string) {
+    int length = strlen(string);
+    char* copy = malloc(length + 1);
+    memcpy(copy, string, length + 1);
+    return copy;
+}
+
+static void parseJobsFile(struct Fleet* fleet, const char* path) {
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) {
+        printf("Error: could not read file \"%s\".\n", path);
+        exit(1);
+    }
+
+    char line[1024] = {0};
+    int lineNumber = 0;
+    int capacity = 64;
+    fleet->jobs = malloc(capacity * sizeof(struct Job));
+    fleet->jobCount = 0;
+
+    while (fgets(line, 1023, file) != NULL) {
+        ++lineNumber;
+
+        char* binaryFilePath = strtok(line, " \t\n");
+        char* inputFilePath = strtok(NULL, " \t\n");
+        char* outputFilePath = strtok(NULL, " \t\n");
+
+        if (binaryFilePath == NULL || binaryFilePath[0] == '#') continue;
+
+        if (outputFilePath == NULL || strtok(NULL, " \t\n") != NULL) {
+            printf("Error: in file \"%s\" line %d must have three columns.\n", path, lineNumber);
+            exit(1);
+        }
+
+        if (fleet->jobCount == capacity) {
+            capacity *= 2;
+            fleet->jobs = realloc(fleet->jobs, capacity * sizeof(struct Job));
+        }
+
+        fleet->jobs[fleet->jobCount++] = (struct Job) {
+            copyString(binaryFilePath),
+            strcmp(inputFilePath, "-") == 0 ? NULL : copyString(inputFilePath),
+            copyString(outputFilePath)
+        };
+    }
+
+    fclose(file);
+}
+
+static void runJob(struct Fleet* fleet, struct Job* job) {
+    struct MachineState* state = malloc(sizeof(struct MachineState));
+    *state = getInitialState();
+
+    if (!loadProgram(state, job->binaryFilePath)) {
+        job->failed = true;
+        free(state);
+        return;
+    }
+
+    FILE* inputFile = fopen(job->inputFilePath != NULL ? job->inputFilePath : "/dev/null", "rb");
+    FILE* outputFile = fopen(job->outputFilePath, "wb");
+
+    if (inputFile == NULL || outputFile == NULL) {
+        printf("Error: could not open file \"%s\".\n", inputFile == NULL ? job->inputFilePath : job->outputFilePath);
+        job->failed = true;
+    } else {
+        struct KeyboardInput* keyboardInput = malloc(sizeof(struct KeyboardInput));
+        struct TerminalOutput* terminalOutput = malloc(sizeof(struct TerminalOutput));
+        *keyboardInput = getKeyboardInput(InputBackpressureBlock);
+        *terminalOutput = getTerminalOutput(OutputBufferPolicyFull, outputFile);
+
+        state->keyboardInput = keyboardInput;
+        state->terminalOutput = terminalOutput;
+        state->clockFrequencyKiloHz = fleet->clockFrequencyKiloHz;
+        state->isTimeVirtual = fleet->isTimeVirtual;
+
+        struct Engine engine = createEngine(fleet->engineType);
+        unsigned long long startTimeNs = getTimeNs();
+        runDefault(state, &engine, inputFile, fleet->maxCycles, fleet->maxTimeMs, fleet->detectsNonTermination);
+        job->wallTimeNs = getTimeNs() - startTimeNs;
+        job->haltReason = state->haltReason;
+        job->cycleCount = state->cycleCount;
+
+        destroyEngine(&engine);
+
+        free(keyboardInput);
+        free(terminalOutput);
+    }
+
+    if (inputFile != NULL) fclose(inputFile);
+    if (outputFile != NULL) fclose(outputFile);
+    free(state);
+}
+
+// Returns the index of a job that no other worker will run, or -1 if all jobs were claimed
+static int claimJob(struct Worker* worker) {
+    struct Fleet* fleet = worker->fleet;
+    int workerIndex = worker - fleet->workers;
+
+    for (int i = 0; i < fleet->workerCount; ++i) {
+        struct Worker* victim = &fleet->workers[(workerIndex + i) % fleet->workerCount];
+        if (atomic_load(&victim->nextJob) >= victim->endJob) continue;
+
+        int job = atomic_fetch_add(&victim->nextJob, 1);
+        if (job < victim->endJob) return job;
+    }
+
+    return -1;
+}
+
+static void* runWorker(void* context) {
+    struct Worker* worker = context;
+
+    for (int job = claimJob(worker); job >= 0; job = claimJob(worker)) {
+        runJob(worker->fleet, &worker->fleet->jobs[job]);
+    }
+
+    return NULL;
+}
+
+static void printSummary(struct Fleet* fleet, unsigned long long wallTimeNs) {
+    unsigned long long totalCycles = 0;
+    unsigned long long totalJobTimeNs = 0;
+    int failedJobs = 0;
+
+    printf("%6s  %-15s  %14s  %12s  %s\n", "Job", "Result", "Cycles", "Time [ms]", "Binary");
+
+    for (int i = 0; i < fleet->jobCount; ++i) {
+        struct Job* job = &fleet->jobs[i];
+        printf("%6d  %-15s  %14llu  %12.3f  %s\n", i + 1, getHaltReasonName(job), job->cycleCount, job->wallTimeNs / 1e6, job->binaryFilePath);
+
+        totalCycles += job->cycleCount;
+        totalJobTimeNs += job->wallTimeNs;
+        if (job->failed) ++failedJobs;
+    }
+
+    printf("%d jobs (%d failed) on %d threads: %llu cycles, %.3f ms of job time, %.3f ms of wall time.\n",
+        fleet->jobCount, failedJobs, fleet->workerCount, totalCycles, totalJobTimeNs / 1e6, wallTimeNs / 1e6);
+}
+
+bool runFleet(const char* jobsFilePath, int threadCount, enum EngineType engineType, int clockFrequencyKiloHz, bool isTimeVirtual, unsigned long long maxCycles, unsigned long maxTimeMs, bool detectsNonTermination) {
+    struct Fleet fleet = { NULL, 0, NULL, 0, engineType, clockFrequencyKiloHz, isTimeVirtual, maxCycles, maxTimeMs, detectsNonTermination };
+
+    parseJobsFile(&fleet, jobsFilePath);
+
+    if (threadCount == 0) threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadCount > fleet.jobCount) threadCount = fleet.jobCount;
+    if (threadCount < 1) threadCount = 1;
+
+    fleet.workerCount = threadCount;
+    fleet.workers = calloc(threadCount, sizeof(struct Worker));
+
+    unsigned long long startTimeNs = getTimeNs();
+
+    for (int i = 0; i < threadCount; ++i) {
+        fleet.workers[i].fleet = &fleet;
+        atomic_store(&fleet.workers[i].nextJob, fleet.jobCount * i / threadCount);
+        fleet.workers[i].endJob = fleet.jobCount * (i + 1) / threadCount;
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        pthread_create(&fleet.workers[i].thread, NULL, runWorker, &fleet.workers[i]);
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        pthread_join(fleet.workers[i].thread, NULL);
+    }
+
+    printSummary(&fleet, getTimeNs() - startTimeNs);
+
+    bool anyJobFailed = false;
+
+    for (int i = 0; i < fleet.jobCount; ++i) {
+        anyJobFailed = anyJobFailed || fleet.jobs[i].failed;
+        free(fleet.jobs[i].binaryFilePath);
+        free(fleet.jobs[i].inputFilePath);
+        free(fleet.jobs[i].outputFilePath);
+    }
+
+    free(fleet.jobs);
+    free(fleet.workers);
+
+    return !anyJobFailed;
+}
@@ -0,0 +1,12 @@
+#ifndef fleet_runtime
+#define fleet_runtime
+
+#include "../engine/engine.h"
+#include <stdbool.h>
+
+// Runs the jobs listed in the file on a pool of threads (one per CPU if threadCount is 0) and prints a summary. Each line
+// of the file lists a binary file path, an input file path (or "-" for no input), and an output file path. Returns false
+// if any job couldn't be started.
+bool runFleet(const char* jobsFilePath, int threadCount, enum EngineType engineType, int clockFrequencyKiloHz, bool isTimeVirtual, unsigned long long maxCycles, unsigned long maxTimeMs, bool detectsNonTermination);
+
+#endif
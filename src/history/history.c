@@ -0,0 +1,279 @@
+#include "history.h"
+#include "../machine-state/machine-state.h"
+#include "../terminal-output/terminal-output.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+static struct Checkpoint* getCheckpoint(struct History* history, int index) {
+    return &history->checkpoints[index % MAX_CHECKPOINTS];
+}
+
+static void restoreCheckpoint(struct History* history, struct MachineState* state, int index) {
+    struct Checkpoint* checkpoint = getCheckpoint(history, index);
+
+    memcpy(state->memory, checkpoint->memory, ADDRESS_SPACE_SIZE);
+    invalidateDecodedInstructions(state);
+    state->PC = checkpoint->PC;
+    state->A = checkpoint->A;
+    state->cycleCount = checkpoint->cycleCount;
+    state->haltReason = HaltReasonNone;
+
+    history->currentCheckpoint = index % MAX_CHECKPOINTS;
+    history->instructionCount = checkpoint->instructionCount;
+    history->registerReadPosition = 0;
+    history->undoLogLength = 0;
+}
+
+// Checkpoints are taken at the same positions when replaying, so the next one already exists then
+static void enterNextCheckpoint(struct History* history, struct MachineState* state) {
+    history->undoLogLength = 0;
+    history->registerReadPosition = 0;
+
+    if (isReplayingHistory(history)) {
+        history->currentCheckpoint = (history->currentCheckpoint + 1) % MAX_CHECKPOINTS;
+        return;
+    }
+
+    if (history->checkpointCount == MAX_CHECKPOINTS) {
+        history->oldestCheckpoint = (history->oldestCheckpoint + 1) % MAX_CHECKPOINTS;
+        --history->checkpointCount;
+    }
+
+    int index = (history->oldestCheckpoint + history->checkpointCount++) % MAX_CHECKPOINTS;
+    struct Checkpoint* checkpoint = &history->checkpoints[index];
+
+    checkpoint->instructionCount = history->instructionCount;
+    checkpoint->cycleCount = state->cycleCount;
+    checkpoint->PC = state->PC;
+    checkpoint->A = state->A;
+    memcpy(checkpoint->memory, state->memory, ADDRESS_SPACE_SIZE);
+    checkpoint->registerReadCount = 0; // the buffer is reused
+
+    history->currentCheckpoint = index;
+}
+
+struct History* createHistory(struct MachineState* state) {
+    struct History* history = calloc(1, sizeof(struct History));
+    history->discardedOutput = getTerminalOutput(OutputBufferPolicyFull, NULL);
+    enterNextCheckpoint(history, state);
+    return history;
+}
+
+void destroyHistory(struct History* history) {
+    for (int i = 0; i < MAX_CHECKPOINTS; ++i) free(history->checkpoints[i].registerReads);
+    free(history);
+}
+
+void resetHistory(struct History* history, struct MachineState* state) {
+    history->checkpointCount = 0;
+    history->instructionCount = 0;
+    history->presentInstructionCount = 0;
+    enterNextCheckpoint(history, state);
+}
+
+int stepWithHistory(struct History* history, struct MachineState* state) {
+    unsigned short PC = state->PC;
+    bool isFetchingRegisters = PC >= TIME_INTERFACE_ADDRESS - 1; // which may store anywhere, so they start a checkpoint
+
+    if (history->undoLogLength == CHECKPOINT_INTERVAL || (isFetchingRegisters && history->undoLogLength > 0)) {
+        enterNextCheckpoint(history, state);
+    }
+
+    struct UndoEntry* entry = &history->undoLog[history->undoLogLength++];
+    entry->PC = PC;
+    entry->A = state->A;
+    entry->storedAddress = NO_STORE;
+
+    if (!isFetchingRegisters) {
+        struct DecodedInstruction decoded = getDecodedInstruction(state, PC);
+
+        if (decoded.opcode == 4 && decoded.argument != IO_INTERFACE_ADDRESS) {
+            entry->storedAddress = decoded.argument;
+            entry->storedValue = state->memory[decoded.argument];
+        }
+    }
+
+    int registerReadPosition = history->registerReadPosition;
+    bool isReplaying = isReplayingHistory(history);
+    struct TerminalOutput* output = state->terminalOutput;
+
+    if (isReplaying) state->terminalOutput = &history->discardedOutput; // it was written when the instruction was recorded
+
+    int cycles = step(state);
+
+    state->terminalOutput = output;
+    entry->clockCycles = cycles;
+    entry->registerReadCount = history->registerReadPosition - registerReadPosition;
+
+    ++history->instructionCount;
+    if (!isReplaying) history->presentInstructionCount = history->instructionCount;
+
+    return cycles;
+}
+
+// Straight-line code runs inline with the registers in local variables, they're synchronized with the state and the
+// history when stepWithHistory() handles checkpoints, replaying, and memory-mapped registers
+unsigned long runBlocksWithHistory(struct History* history, struct MachineState* state, const unsigned short* blockLengths, const bool* stopAddresses, volatile bool* isInterrupted, unsigned long cycleBudget) {
+    unsigned long cycles = 0;
+    unsigned short PC = state->PC;
+    unsigned char A = state->A;
+    unsigned long long cycleCount = state->cycleCount;
+    unsigned long long instructionCount = history->instructionCount;
+    struct UndoEntry* undoLog = history->undoLog;
+    int undoLogLength = history->undoLogLength;
+    int remainingLength = blockLengths[PC];
+
+    while (true) {
+        unsigned short nextPC = (PC + 2) % ADDRESS_SPACE_SIZE;
+        struct DecodedInstruction decoded = PC < TIME_INTERFACE_ADDRESS - 1 ? getDecodedInstruction(state, PC) : (struct DecodedInstruction) {0};
+        bool accessesRegisters = decoded.argument >= TIME_INTERFACE_ADDRESS && decoded.opcode <= 4;
+
+        if (decoded.clockCycles == 0 || accessesRegisters || undoLogLength == CHECKPOINT_INTERVAL || instructionCount < history->presentInstructionCount) {
+            state->PC = PC;
+            state->A = A;
+            state->cycleCount = cycleCount;
+            history->instructionCount = instructionCount;
+            history->undoLogLength = undoLogLength;
+
+            cycles += stepWithHistory(history, state);
+
+            PC = state->PC;
+            A = state->A;
+            cycleCount = state->cycleCount;
+            instructionCount = history->instructionCount;
+            undoLogLength = history->undoLogLength;
+
+            if (state->haltReason != HaltReasonNone) break;
+        } else {
+            struct UndoEntry* entry = &undoLog[undoLogLength++];
+            *entry = (struct UndoEntry) { PC, NO_STORE, A, 0, decoded.clockCycles, 0 };
+
+            unsigned short argument = decoded.argument;
+            bool isHalting = false;
+            PC = nextPC;
+
+            switch (decoded.opcode) {
+                case 0: A = state->memory[argument]; break;
+                case 1: A = ~state->memory[argument]; break;
+                case 2: A += state->memory[argument]; break;
+                case 3: A &= state->memory[argument]; break;
+                case 4:
+                    entry->storedAddress = argument;
+                    entry->storedValue = state->memory[argument];
+                    setMemory(state, argument, A);
+                    break;
+                case 5:
+                    isHalting = argument == entry->PC;
+                    PC = isHalting ? entry->PC : argument;
+                    break;
+                case 6: if (A & 0x80) PC = argument; break;
+                case 7: if (A == 0) PC = argument; break;
+            }
+
+            cycleCount += decoded.clockCycles;
+            cycles += decoded.clockCycles;
+            ++instructionCount;
+
+            if (isHalting) {
+                state->haltReason = HaltReasonInfiniteLoop;
+                break;
+            }
+        }
+
+        if (PC == nextPC && --remainingLength > 0) continue;
+
+        if (stopAddresses[PC] || *isInterrupted || cycles >= cycleBudget) break;
+        remainingLength = blockLengths[PC];
+    }
+
+    state->PC = PC;
+    state->A = A;
+    state->cycleCount = cycleCount;
+    history->instructionCount = instructionCount;
+    history->undoLogLength = undoLogLength;
+    if (history->presentInstructionCount < instructionCount) history->presentInstructionCount = instructionCount;
+
+    return cycles;
+}
+
+void recordHistoryRegisterRead(struct History* history, unsigned char value) {
+    struct Checkpoint* checkpoint = &history->checkpoints[history->currentCheckpoint];
+
+    if (checkpoint->registerReadCount == checkpoint->registerReadCapacity) {
+        checkpoint->registerReadCapacity = checkpoint->registerReadCapacity == 0 ? 256 : checkpoint->registerReadCapacity * 2;
+        checkpoint->registerReads = realloc(checkpoint->registerReads, checkpoint->registerReadCapacity);
+    }
+
+    checkpoint->registerReads[checkpoint->registerReadCount++] = value;
+    history->registerReadPosition = checkpoint->registerReadCount;
+}
+
+unsigned char replayHistoryRegisterRead(struct History* history) {
+    struct Checkpoint* checkpoint = &history->checkpoints[history->currentCheckpoint];
+    if (history->registerReadPosition >= checkpoint->registerReadCount) return 0;
+    return checkpoint->registerReads[history->registerReadPosition++];
+}
+
+static void undoInstruction(struct History* history, struct MachineState* state) {
+    struct UndoEntry* entry = &history->undoLog[--history->undoLogLength];
+
+    if (history->undoLogLength == 0) {
+        restoreCheckpoint(history, state, history->currentCheckpoint);
+        return;
+    }
+
+    if (entry->storedAddress != NO_STORE) setMemory(state, entry->storedAddress, entry->storedValue);
+
+    state->PC = entry->PC;
+    state->A = entry->A;
+    state->cycleCount -= entry->clockCycles;
+    state->haltReason = HaltReasonNone;
+
+    history->registerReadPosition -= entry->registerReadCount;
+    --history->instructionCount;
+}
+
+static void replayUntil(struct History* history, struct MachineState* state, unsigned long long instructionCount) {
+    while (history->instructionCount < instructionCount) stepWithHistory(history, state);
+}
+
+// The position must be in the history, before the current one
+static void goBackTo(struct History* history, struct MachineState* state, unsigned long long instructionCount) {
+    if (instructionCount < history->checkpoints[history->currentCheckpoint].instructionCount) {
+        int index = history->currentCheckpoint;
+        while (getCheckpoint(history, index)->instructionCount > instructionCount) index += MAX_CHECKPOINTS - 1;
+        restoreCheckpoint(history, state, index);
+        replayUntil(history, state, instructionCount);
+    } else {
+        while (history->instructionCount > instructionCount) undoInstruction(history, state);
+    }
+}
+
+bool stepBack(struct History* history, struct MachineState* state) {
+    if (history->instructionCount == history->checkpoints[history->oldestCheckpoint].instructionCount) return false;
+
+    goBackTo(history, state, history->instructionCount - 1);
+    return true;
+}
+
+// Earlier instructions aren't in the undo log, so they're replayed one checkpoint at a time
+bool reverseContinue(struct History* history, struct MachineState* state, bool* breakpoints) {
+    while (true) {
+        for (int i = history->undoLogLength - 1; i >= 0; --i) {
+            if (breakpoints[history->undoLog[i].PC]) {
+                goBackTo(history, state, history->checkpoints[history->currentCheckpoint].instructionCount + i);
+                return true;
+            }
+        }
+
+        if (history->currentCheckpoint == history->oldestCheckpoint) {
+            restoreCheckpoint(history, state, history->currentCheckpoint);
+            return false;
+        }
+
+        unsigned long long end = history->checkpoints[history->currentCheckpoint].instructionCount;
+        restoreCheckpoint(history, state, history->currentCheckpoint + MAX_CHECKPOINTS - 1);
+        replayUntil(history, state, end);
+    }
+}
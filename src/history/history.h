@@ -0,0 +1,85 @@
+#ifndef history_h
+#define history_h
+
+#include "../machine-state/machine-state.h"
+#include "../terminal-output/terminal-output.h"
+#include <stdbool.h>
+
+#define CHECKPOINT_INTERVAL 0x10000 // instructions
+#define MAX_CHECKPOINTS 256 // the oldest checkpoint is dropped when a new one doesn't fit
+#define NO_STORE 0xffff
+
+// Reverts one instruction, unless it's the first one after a checkpoint, which is reverted by restoring the checkpoint
+struct UndoEntry {
+    unsigned short PC;
+    unsigned short storedAddress; // NO_STORE if the instruction didn't write to memory
+    unsigned char A;
+    unsigned char storedValue; // overwritten by the instruction
+    unsigned char clockCycles;
+    unsigned char registerReadCount;
+};
+
+struct Checkpoint {
+    unsigned long long instructionCount; // position in the history
+    unsigned long long cycleCount;
+    unsigned short PC;
+    unsigned char A;
+    unsigned char memory[ADDRESS_SPACE_SIZE];
+    unsigned char* registerReads; // values read from memory-mapped registers until the next checkpoint
+    int registerReadCount;
+    int registerReadCapacity;
+};
+
+// Execution history of the debugger. The state at any position since the oldest checkpoint is recreated by undoing
+// instructions since the current checkpoint, or by restoring an earlier checkpoint and executing instructions again with
+// the recorded register reads. Instructions executed again after going back in the history are replayed the same way
+// until they catch up with the present.
+struct History {
+    struct Checkpoint checkpoints[MAX_CHECKPOINTS]; // ring buffer
+    int oldestCheckpoint;
+    int checkpointCount;
+    int currentCheckpoint; // the last checkpoint at or before the current position
+    int registerReadPosition; // in the current checkpoint
+    unsigned long long instructionCount; // current position
+    unsigned long long presentInstructionCount;
+    struct UndoEntry undoLog[CHECKPOINT_INTERVAL]; // instructions since the current checkpoint
+    int undoLogLength;
+    struct TerminalOutput discardedOutput; // replaces the terminal output while replaying
+};
+
+// Starts the history at the state
+struct History* createHistory(struct MachineState* state);
+
+void destroyHistory(struct History* history);
+
+// Forgets the history and starts it again at the state, e.g. after the state was modified
+void resetHistory(struct History* history, struct MachineState* state);
+
+static inline bool isReplayingHistory(struct History* history) {
+    return history->instructionCount < history->presentInstructionCount;
+}
+
+// Has the same semantics as step(), and records the instruction in the history, or replays it if the current position is
+// in the past
+int stepWithHistory(struct History* history, struct MachineState* state);
+
+// Has the same semantics as calling stepWithHistory() until at least cycleBudget clock cycles elapse, the simulation halts,
+// or after the first instruction, the PC reaches a stop address or the interrupted flag is set. Execution is split into
+// straight-line blocks: blockLengths has the number of instructions that can be executed from each address without
+// reaching a stop address, and the conditions are only checked when a jump or the block length ends a block.
+unsigned long runBlocksWithHistory(struct History* history, struct MachineState* state, const unsigned short* blockLengths, const bool* stopAddresses, volatile bool* isInterrupted, unsigned long cycleBudget);
+
+// Called when the machine reads a memory-mapped register at the present
+void recordHistoryRegisterRead(struct History* history, unsigned char value);
+
+// Called instead of reading a memory-mapped register while replaying
+unsigned char replayHistoryRegisterRead(struct History* history);
+
+// Goes back by one instruction. Returns false at the beginning of the history.
+bool stepBack(struct History* history, struct MachineState* state);
+
+// Goes back to the last position before the current one where the PC is at a breakpoint. Returns false if there's none
+// in the history, after going back to its beginning.
+bool reverseContinue(struct History* history, struct MachineState* state, bool* breakpoints);
+
+#endif
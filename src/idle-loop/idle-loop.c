@@ -0,0 +1,105 @@
+#include "idle-loop.h"
+#include "../machine-state/machine-state.h"
+#include "../keyboard-input/keyboard-input.h"
+#include "../terminal-output/terminal-output.h"
+#include "../clock-pacer/clock-pacer.h"
+#include "../time/time.h"
+
+#define MAX_IDLE_LOOP_INSTRUCTIONS 64
+#define MAX_IDLE_WAIT_NS 10000000ull // limits how late the runtime notices time limits
+
+struct IdleLoop findIdleLoop(struct MachineState* state) {
+    struct IdleLoop loop = { 0, false, false };
+    struct IdleLoop noLoop = { 0, false, false };
+    unsigned short PC = state->PC;
+    unsigned char A = state->A;
+    unsigned int cycles = 0;
+
+    // Executes one iteration without side effects, giving up on anything that could make the next iteration different
+    for (int i = 0; i < MAX_IDLE_LOOP_INSTRUCTIONS; ++i) {
+        if (PC >= TIME_INTERFACE_ADDRESS - 1) return noLoop; // fetching the instruction has side effects
+
+        struct DecodedInstruction instruction = getDecodedInstruction(state, PC);
+        unsigned short argument = instruction.argument;
+        unsigned char value = 0;
+
+        if (instruction.opcode < 4) { // LD, NOT, ADD, AND
+            if (argument == IO_INTERFACE_ADDRESS) {
+                if (peekLastChar(state->keyboardInput) != 0 || hasInputEnded(state->keyboardInput)) return noLoop;
+                loop.readsInput = true;
+            } else if (argument == TIME_INTERFACE_ADDRESS) {
+                if (measureTimeMs(state, state->cycleCount + cycles) != state->simulationMeasuredTimeMs) return noLoop;
+                loop.readsTime = true;
+                value = peekMemory(state, argument);
+            } else {
+                value = peekMemory(state, argument);
+            }
+        }
+
+        cycles += instruction.clockCycles;
+
+        switch (instruction.opcode) {
+            case 0: A = value; break; // LD
+            case 1: A = ~value; break; // NOT
+            case 2: A += value; break; // ADD
+            case 3: A &= value; break; // AND
+            case 4: return noLoop; // ST
+            case 5: if (argument == PC) return noLoop; break; // JMP
+            case 6: if (!(A & 0x80)) argument = PC + 2; break; // JMN
+            case 7: if (A != 0) argument = PC + 2; break; // JMZ
+        }
+
+        PC = instruction.opcode < 5 ? PC + 2 : argument;
+        PC %= ADDRESS_SPACE_SIZE;
+
+        if (PC == state->PC) {
+            if (A != state->A || (!loop.readsInput && !loop.readsTime)) return noLoop;
+
+            loop.cycles = cycles;
+            return loop;
+        }
+    }
+
+    return noLoop;
+}
+
+unsigned long long skipIdleLoop(struct MachineState* state, struct IdleLoop loop, unsigned long long maxCycles) {
+    flushOutput(state->terminalOutput);
+
+    unsigned long long skippedCycles = 0;
+    int clockFrequencyKiloHz = state->clockFrequencyKiloHz;
+
+    if (state->isTimeVirtual && loop.readsTime) {
+        // Time only passes with cycles, so skip the iterations that end before the next millisecond
+        unsigned long long nextMillisecondCycles = (state->cycleCount / clockFrequencyKiloHz + 1) * clockFrequencyKiloHz;
+        skippedCycles = (nextMillisecondCycles - state->cycleCount) / loop.cycles * loop.cycles;
+    } else {
+        unsigned long long startTimeNs = getTimeNs();
+        unsigned long long deadlineNs = startTimeNs + MAX_IDLE_WAIT_NS;
+
+        if (loop.readsTime) {
+            unsigned long long nextMillisecondNs = (getTimeMs() + 1) * 1000000ull;
+            if (nextMillisecondNs < deadlineNs) deadlineNs = nextMillisecondNs;
+        }
+
+        if (loop.readsInput) {
+            waitForInput(state->keyboardInput, deadlineNs);
+        } else {
+            sleepUntilNs(deadlineNs);
+        }
+
+        // Without a clock frequency it's unknown how many iterations would have run
+        if (!state->isTimeVirtual && clockFrequencyKiloHz != UNLIMITED_CLOCK_FREQUENCY) {
+            unsigned long long elapsedCycles = (getTimeNs() - startTimeNs) * clockFrequencyKiloHz / 1000000;
+            skippedCycles = elapsedCycles / loop.cycles * loop.cycles;
+        }
+    }
+
+    if (maxCycles != 0 && state->cycleCount + skippedCycles > maxCycles) {
+        skippedCycles = (maxCycles - state->cycleCount) / loop.cycles * loop.cycles;
+    }
+
+    state->cycleCount += skippedCycles;
+
+    return skippedCycles;
+}
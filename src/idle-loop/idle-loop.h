@@ -0,0 +1,21 @@
+#ifndef idle_loop
+#define idle_loop
+
+#include "../machine-state/machine-state.h"
+#include <stdbool.h>
+
+struct IdleLoop {
+    unsigned int cycles; // clock cycles of one iteration, 0 if the machine isn't in an idle loop
+    bool readsInput;
+    bool readsTime;
+};
+
+// Checks if the machine is in a polling loop without side effects, whose iterations stay the same until input arrives or
+// the clock register changes
+struct IdleLoop findIdleLoop(struct MachineState* state);
+
+// Waits until the loop may behave differently, instead of running it, and advances the cycle count by whole iterations as
+// if it was running. Returns the number of cycles added.
+unsigned long long skipIdleLoop(struct MachineState* state, struct IdleLoop loop, unsigned long long maxCycles);
+
+#endif
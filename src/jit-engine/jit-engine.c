@@ -0,0 +1,427 @@
+#include "jit-engine.h"
+#include "../machine-state/machine-state.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+
+#include <sys/mman.h> // POSIX
+
+#define CODE_BUFFER_SIZE 0x400000
+#define MAX_BLOCK_INSTRUCTIONS 64
+#define MAX_BLOCK_BYTES (2 * MAX_BLOCK_INSTRUCTIONS + 2)
+#define MAX_BLOCK_CODE_SIZE (160 * MAX_BLOCK_INSTRUCTIONS + 256)
+#define MAX_BLOCK_CYCLES (4 * MAX_BLOCK_INSTRUCTIONS)
+#define FIRST_UNTRANSLATABLE_ADDRESS (TIME_INTERFACE_ADDRESS - 1) // instructions from here on overlap memory-mapped registers
+#define HOT_BYTE_INVALIDATIONS 4 // instructions overlapping a byte stored to this many times are read from memory at run time
+
+#define STATE_MEMORY_OFFSET offsetof(struct MachineState, memory)
+#define STATE_PC_OFFSET offsetof(struct MachineState, PC)
+#define STATE_A_OFFSET offsetof(struct MachineState, A)
+#define STATE_DECODED_CYCLES_OFFSET(address) (offsetof(struct MachineState, decodedInstructions) \
+    + (address) * sizeof(struct DecodedInstruction) + offsetof(struct DecodedInstruction, clockCycles))
+
+#define EMIT(jit, ...) emitBytes(jit, (const unsigned char[]) { __VA_ARGS__ }, sizeof((const unsigned char[]) { __VA_ARGS__ }))
+
+enum JitExit {
+    JitExitContinue = 0,
+    JitExitInterpret = 1, // the instruction at PC must be executed by step()
+    JitExitInvalidate = 2 // blocks translated from the address in the higher bits must be discarded
+};
+
+struct Jit;
+
+typedef int (*JitEntry)(struct MachineState* state, struct Jit* jit, long remainingCycles, void* block);
+
+// Generated code keeps the state in rbx, A in r12b, the remaining cycles in r13, and the Jit in r14.
+// Jumps are always translated from the current memory contents, so that patching the argument of a jump
+// (as W13 subroutine returns do) doesn't discard any blocks. Other instructions are translated to constant code,
+// unless they overlap a hot byte: W13 has no indirect addressing, so loops over memory patch their own LD and ST
+// arguments, and recompiling their blocks on every iteration would be slower than interpreting them.
+struct Jit {
+    void* blocks[ADDRESS_SPACE_SIZE]; // native code of the block starting at each address, or NULL
+    unsigned short blockEnds[ADDRESS_SPACE_SIZE]; // address following the last instruction of each block
+    unsigned short constantEnds[ADDRESS_SPACE_SIZE]; // address following the last instruction of each block translated to constant code
+    unsigned long long dynamicInstructions[ADDRESS_SPACE_SIZE]; // bit i is set if instruction i of each block is read from memory
+    unsigned short constantCodeCounts[ADDRESS_SPACE_SIZE]; // number of blocks with constant code translated from each byte
+    unsigned char invalidationCounts[ADDRESS_SPACE_SIZE]; // number of stores to each byte that discarded blocks, up to HOT_BYTE_INVALIDATIONS
+    long remainingCycles;
+    unsigned char* code;
+    size_t codeUsed;
+    size_t trampolineSize;
+    JitEntry enter;
+    unsigned char* exitContinue;
+    unsigned char* exitEpilogue;
+};
+
+static void emitBytes(struct Jit* jit, const unsigned char* bytes, size_t count) {
+    memcpy(jit->code + jit->codeUsed, bytes, count);
+    jit->codeUsed += count;
+}
+
+static void emit16(struct Jit* jit, unsigned short value) {
+    EMIT(jit, value, value >> 8);
+}
+
+static void emit32(struct Jit* jit, unsigned int value) {
+    EMIT(jit, value, value >> 8, value >> 16, value >> 24);
+}
+
+static void emitRelative32(struct Jit* jit, unsigned char* target) {
+    emit32(jit, target - (jit->code + jit->codeUsed + 4));
+}
+
+static void patchRelative32(struct Jit* jit, size_t patchOffset) {
+    unsigned int relative = jit->codeUsed - (patchOffset + 4);
+    memcpy(jit->code + patchOffset, &relative, 4);
+}
+
+// Emits a short conditional jump over the code that follows, until patchShortJump() is called
+static size_t emitShortJump(struct Jit* jit, unsigned char opcode) {
+    EMIT(jit, opcode, 0);
+    return jit->codeUsed - 1;
+}
+
+static void patchShortJump(struct Jit* jit, size_t patchOffset) {
+    jit->code[patchOffset] = jit->codeUsed - (patchOffset + 1);
+}
+
+static void emitTrampoline(struct Jit* jit) {
+    jit->enter = (JitEntry) (void*) jit->code;
+    EMIT(jit, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56); // push rbx, r12, r13, r14
+    EMIT(jit, 0x48, 0x89, 0xFB); // mov rbx, rdi
+    EMIT(jit, 0x49, 0x89, 0xF6); // mov r14, rsi
+    EMIT(jit, 0x49, 0x89, 0xD5); // mov r13, rdx
+    EMIT(jit, 0x44, 0x0F, 0xB6, 0xA3); emit32(jit, STATE_A_OFFSET); // movzx r12d, byte [rbx + A]
+    EMIT(jit, 0xFF, 0xE1); // jmp rcx
+
+    jit->exitContinue = jit->code + jit->codeUsed;
+    EMIT(jit, 0x31, 0xC0); // xor eax, eax
+
+    jit->exitEpilogue = jit->code + jit->codeUsed;
+    EMIT(jit, 0x44, 0x88, 0xA3); emit32(jit, STATE_A_OFFSET); // mov [rbx + A], r12b
+    EMIT(jit, 0x4D, 0x89, 0xAE); emit32(jit, offsetof(struct Jit, remainingCycles)); // mov [r14 + remainingCycles], r13
+    EMIT(jit, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3); // pop r14, r13, r12, rbx; ret
+
+    jit->trampolineSize = jit->codeUsed;
+}
+
+static void emitExitStub(struct Jit* jit, unsigned short PC, unsigned int cycles, unsigned int exit) {
+    EMIT(jit, 0x66, 0xC7, 0x83); emit32(jit, STATE_PC_OFFSET); emit16(jit, PC); // mov word [rbx + PC], imm16
+    EMIT(jit, 0x49, 0x81, 0xED); emit32(jit, cycles); // sub r13, imm32
+    EMIT(jit, 0xB8); emit32(jit, exit); // mov eax, imm32
+    EMIT(jit, 0xE9); emitRelative32(jit, jit->exitEpilogue); // jmp epilogue
+}
+
+// Jumps to the block in rcx, unless it doesn't exist or it could exceed the cycle budget
+static void emitChainJump(struct Jit* jit) {
+    EMIT(jit, 0x48, 0x85, 0xC9); // test rcx, rcx
+    EMIT(jit, 0x0F, 0x84); emitRelative32(jit, jit->exitContinue); // jz exitContinue
+    EMIT(jit, 0x49, 0x81, 0xFD); emit32(jit, MAX_BLOCK_CYCLES); // cmp r13, MAX_BLOCK_CYCLES
+    EMIT(jit, 0x0F, 0x8C); emitRelative32(jit, jit->exitContinue); // jl exitContinue
+    EMIT(jit, 0xFF, 0xE1); // jmp rcx
+}
+
+static void emitChainToConstantAddress(struct Jit* jit, unsigned short address, unsigned int cycles) {
+    EMIT(jit, 0x49, 0x81, 0xED); emit32(jit, cycles); // sub r13, imm32
+    EMIT(jit, 0x66, 0xC7, 0x83); emit32(jit, STATE_PC_OFFSET); emit16(jit, address); // mov word [rbx + PC], imm16
+    EMIT(jit, 0x49, 0x8B, 0x8E); emit32(jit, offsetof(struct Jit, blocks) + address * sizeof(void*)); // mov rcx, [r14 + blocks[address]]
+    emitChainJump(jit);
+}
+
+// The address is in eax
+static void emitChainToDynamicAddress(struct Jit* jit, unsigned int cycles) {
+    EMIT(jit, 0x49, 0x81, 0xED); emit32(jit, cycles); // sub r13, imm32
+    EMIT(jit, 0x66, 0x89, 0x83); emit32(jit, STATE_PC_OFFSET); // mov [rbx + PC], ax
+    EMIT(jit, 0x49, 0x8B, 0x8C, 0xC6); emit32(jit, offsetof(struct Jit, blocks)); // mov rcx, [r14 + blocks + rax * 8]
+    emitChainJump(jit);
+}
+
+static void emitStore(struct Jit* jit, unsigned short address, unsigned short argument, unsigned int cycles) {
+    EMIT(jit, 0x44, 0x88, 0xA3); emit32(jit, STATE_MEMORY_OFFSET + argument); // mov [rbx + memory + argument], r12b
+    EMIT(jit, 0xC6, 0x83); emit32(jit, STATE_DECODED_CYCLES_OFFSET(argument)); EMIT(jit, 0); // mov byte [rbx + decoded cycles], 0
+    EMIT(jit, 0xC6, 0x83); emit32(jit, STATE_DECODED_CYCLES_OFFSET((argument + ADDRESS_SPACE_SIZE - 1) % ADDRESS_SPACE_SIZE)); EMIT(jit, 0);
+    EMIT(jit, 0x66, 0x41, 0x83, 0xBE); emit32(jit, offsetof(struct Jit, constantCodeCounts) + argument * sizeof(unsigned short)); EMIT(jit, 0); // cmp word [r14 + count], 0
+    size_t skipPatch = emitShortJump(jit, 0x74); // je over the stub
+    emitExitStub(jit, address + 2, cycles, (argument << 2) | JitExitInvalidate);
+    patchShortJump(jit, skipPatch);
+}
+
+// Loads the instruction at the address from memory to eax, and exits unless it still has the opcode. Leaves its argument in eax,
+// or exits to step() if it is a memory-mapped register.
+static void emitDynamicInstructionLoad(struct Jit* jit, unsigned short address, unsigned char opcode, unsigned int cyclesBefore) {
+    EMIT(jit, 0x0F, 0xB7, 0x83); emit32(jit, STATE_MEMORY_OFFSET + address); // movzx eax, word [rbx + memory + address]
+    EMIT(jit, 0x89, 0xC1); // mov ecx, eax
+    EMIT(jit, 0xC1, 0xE9, 0x0D); // shr ecx, 13
+    EMIT(jit, 0x83, 0xF9, opcode); // cmp ecx, opcode
+    size_t skipPatch = emitShortJump(jit, 0x74); // je over the stub
+    emitExitStub(jit, address, cyclesBefore, (address << 2) | JitExitInvalidate);
+    patchShortJump(jit, skipPatch);
+    EMIT(jit, 0x25); emit32(jit, 0x1fff); // and eax, 0x1fff
+    EMIT(jit, 0x3D); emit32(jit, TIME_INTERFACE_ADDRESS); // cmp eax, TIME_INTERFACE_ADDRESS
+    skipPatch = emitShortJump(jit, 0x72); // jb over the stub
+    emitExitStub(jit, address, cyclesBefore, JitExitInterpret);
+    patchShortJump(jit, skipPatch);
+}
+
+// The argument is in eax
+static void emitDynamicStore(struct Jit* jit, unsigned short address, unsigned int cycles) {
+    EMIT(jit, 0x44, 0x88, 0xA4, 0x03); emit32(jit, STATE_MEMORY_OFFSET); // mov [rbx + rax + memory], r12b
+    EMIT(jit, 0xC6, 0x84, 0x83); emit32(jit, STATE_DECODED_CYCLES_OFFSET(0)); EMIT(jit, 0); // mov byte [rbx + rax * 4 + decoded cycles], 0
+    EMIT(jit, 0x8D, 0x88); emit32(jit, ADDRESS_SPACE_SIZE - 1); // lea ecx, [rax + ADDRESS_SPACE_SIZE - 1]
+    EMIT(jit, 0x81, 0xE1); emit32(jit, ADDRESS_SPACE_SIZE - 1); // and ecx, ADDRESS_SPACE_SIZE - 1
+    EMIT(jit, 0xC6, 0x84, 0x8B); emit32(jit, STATE_DECODED_CYCLES_OFFSET(0)); EMIT(jit, 0); // mov byte [rbx + rcx * 4 + decoded cycles], 0
+    EMIT(jit, 0x66, 0x41, 0x83, 0xBC, 0x46); emit32(jit, offsetof(struct Jit, constantCodeCounts)); EMIT(jit, 0); // cmp word [r14 + rax * 2 + counts], 0
+    size_t skipPatch = emitShortJump(jit, 0x74); // je over the stub
+    EMIT(jit, 0x66, 0xC7, 0x83); emit32(jit, STATE_PC_OFFSET); emit16(jit, address + 2); // mov word [rbx + PC], imm16
+    EMIT(jit, 0x49, 0x81, 0xED); emit32(jit, cycles); // sub r13, imm32
+    EMIT(jit, 0xC1, 0xE0, 0x02); // shl eax, 2
+    EMIT(jit, 0x83, 0xC8, JitExitInvalidate); // or eax, JitExitInvalidate
+    EMIT(jit, 0xE9); emitRelative32(jit, jit->exitEpilogue); // jmp epilogue
+    patchShortJump(jit, skipPatch);
+}
+
+static void emitJump(struct Jit* jit, unsigned short address, unsigned char opcode, unsigned int cyclesBefore) {
+    unsigned int cycles = cyclesBefore + 3;
+
+    EMIT(jit, 0x0F, 0xB7, 0x83); emit32(jit, STATE_MEMORY_OFFSET + address); // movzx eax, word [rbx + memory + address]
+    EMIT(jit, 0x89, 0xC1); // mov ecx, eax
+    EMIT(jit, 0xC1, 0xE9, 0x0D); // shr ecx, 13
+    EMIT(jit, 0x83, 0xF9, opcode); // cmp ecx, opcode
+    size_t skipPatch = emitShortJump(jit, 0x74); // je over the stub
+    emitExitStub(jit, address, cyclesBefore, (address << 2) | JitExitInvalidate);
+    patchShortJump(jit, skipPatch);
+    EMIT(jit, 0x25); emit32(jit, 0x1fff); // and eax, 0x1fff
+
+    if (opcode == 5) { // JMP
+        EMIT(jit, 0x3D); emit32(jit, address); // cmp eax, address
+        skipPatch = emitShortJump(jit, 0x75); // jne over the stub
+        emitExitStub(jit, address, cyclesBefore, JitExitInterpret);
+        patchShortJump(jit, skipPatch);
+        emitChainToDynamicAddress(jit, cycles);
+        return;
+    }
+
+    if (opcode == 6) { // JMN
+        EMIT(jit, 0x41, 0xF6, 0xC4, 0x80); // test r12b, 0x80
+        EMIT(jit, 0x0F, 0x84); // jz fall through
+    } else { // JMZ
+        EMIT(jit, 0x45, 0x84, 0xE4); // test r12b, r12b
+        EMIT(jit, 0x0F, 0x85); // jnz fall through
+    }
+    size_t fallThroughPatch = jit->codeUsed;
+    emit32(jit, 0);
+
+    emitChainToDynamicAddress(jit, cycles);
+    patchRelative32(jit, fallThroughPatch);
+    emitChainToConstantAddress(jit, (address + 2) % ADDRESS_SPACE_SIZE, cycles);
+}
+
+static void flushJit(struct Jit* jit) {
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->constantCodeCounts, 0, sizeof(jit->constantCodeCounts));
+    jit->codeUsed = jit->trampolineSize;
+}
+
+// Instructions in the bytes of a block that aren't read from memory at run time
+static void countConstantCode(struct Jit* jit, unsigned short start, int increment) {
+    for (int i = start; i < jit->constantEnds[start]; ++i) {
+        if (!(jit->dynamicInstructions[start] >> ((i - start) / 2) & 1)) jit->constantCodeCounts[i] += increment;
+    }
+}
+
+static void discardBlocks(struct Jit* jit, unsigned short address) {
+    int firstStart = address >= MAX_BLOCK_BYTES ? address - MAX_BLOCK_BYTES : 0;
+
+    if (jit->invalidationCounts[address] < HOT_BYTE_INVALIDATIONS) ++jit->invalidationCounts[address];
+
+    for (int start = firstStart; start <= address; ++start) {
+        if (jit->blocks[start] == NULL || jit->blockEnds[start] <= address) continue;
+
+        jit->blocks[start] = NULL;
+        countConstantCode(jit, start, -1);
+    }
+}
+
+static bool isHot(struct Jit* jit, unsigned short address) {
+    return jit->invalidationCounts[address] == HOT_BYTE_INVALIDATIONS || jit->invalidationCounts[address + 1] == HOT_BYTE_INVALIDATIONS;
+}
+
+static void* compileBlock(struct Jit* jit, struct MachineState* state, unsigned short start) {
+    if (start >= FIRST_UNTRANSLATABLE_ADDRESS) return NULL;
+
+    if (CODE_BUFFER_SIZE - jit->codeUsed < MAX_BLOCK_CODE_SIZE) {
+        flushJit(jit);
+    }
+
+    void* block = jit->code + jit->codeUsed;
+    unsigned short address = start;
+    unsigned int cycles = 0;
+    unsigned short blockEnd;
+    unsigned long long dynamicInstructions = 0;
+
+    for (int count = 0;; ++count) {
+        if (address >= FIRST_UNTRANSLATABLE_ADDRESS || count == MAX_BLOCK_INSTRUCTIONS) {
+            emitChainToConstantAddress(jit, address, cycles);
+            blockEnd = address;
+            break;
+        }
+
+        unsigned short instruction = state->memory[address] | (state->memory[address + 1] << 8);
+        unsigned char opcode = instruction >> 13;
+        unsigned short argument = instruction & 0x1fff;
+
+        if (opcode >= 5) { // JMP, JMN, or JMZ
+            emitJump(jit, address, opcode, cycles);
+            blockEnd = address + 2;
+            break;
+        }
+
+        if (argument >= TIME_INTERFACE_ADDRESS) { // memory-mapped registers are left to step()
+            if (count == 0) return NULL;
+            emitChainToConstantAddress(jit, address, cycles);
+            blockEnd = address;
+            break;
+        }
+
+        if (isHot(jit, address)) {
+            emitDynamicInstructionLoad(jit, address, opcode, cycles);
+
+            switch (opcode) {
+                case 0: EMIT(jit, 0x44, 0x8A, 0xA4, 0x03); emit32(jit, STATE_MEMORY_OFFSET); break; // mov r12b, [rbx + rax + memory]
+                case 1:
+                    EMIT(jit, 0x44, 0x8A, 0xA4, 0x03); emit32(jit, STATE_MEMORY_OFFSET); // mov r12b, [rbx + rax + memory]
+                    EMIT(jit, 0x41, 0xF6, 0xD4); // not r12b
+                    break;
+                case 2: EMIT(jit, 0x44, 0x02, 0xA4, 0x03); emit32(jit, STATE_MEMORY_OFFSET); break; // add r12b, [rbx + rax + memory]
+                case 3: EMIT(jit, 0x44, 0x22, 0xA4, 0x03); emit32(jit, STATE_MEMORY_OFFSET); break; // and r12b, [rbx + rax + memory]
+                case 4: emitDynamicStore(jit, address, cycles + 4); break;
+            }
+
+            dynamicInstructions |= 1ULL << count;
+            cycles += 4;
+            address += 2;
+            continue;
+        }
+
+        switch (opcode) {
+            case 0: // LD
+                EMIT(jit, 0x44, 0x8A, 0xA3); emit32(jit, STATE_MEMORY_OFFSET + argument); // mov r12b, [rbx + memory + argument]
+                break;
+            case 1: // NOT
+                EMIT(jit, 0x44, 0x8A, 0xA3); emit32(jit, STATE_MEMORY_OFFSET + argument); // mov r12b, [rbx + memory + argument]
+                EMIT(jit, 0x41, 0xF6, 0xD4); // not r12b
+                break;
+            case 2: // ADD
+                EMIT(jit, 0x44, 0x02, 0xA3); emit32(jit, STATE_MEMORY_OFFSET + argument); // add r12b, [rbx + memory + argument]
+                break;
+            case 3: // AND
+                EMIT(jit, 0x44, 0x22, 0xA3); emit32(jit, STATE_MEMORY_OFFSET + argument); // and r12b, [rbx + memory + argument]
+                break;
+            case 4: // ST
+                emitStore(jit, address, argument, cycles + 4);
+                break;
+        }
+
+        cycles += 4;
+        address += 2;
+    }
+
+    jit->blocks[start] = block;
+    jit->blockEnds[start] = blockEnd;
+    jit->constantEnds[start] = address; // a final jump is read from memory at run time
+    jit->dynamicInstructions[start] = dynamicInstructions;
+    countConstantCode(jit, start, 1);
+
+    return block;
+}
+
+void* createJit() {
+    struct Jit* jit = calloc(1, sizeof(struct Jit));
+    if (jit == NULL) return NULL;
+
+    jit->code = mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->code == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+
+    emitTrampoline(jit);
+
+    return jit;
+}
+
+void destroyJit(void* context) {
+    struct Jit* jit = context;
+    munmap(jit->code, CODE_BUFFER_SIZE);
+    free(jit);
+}
+
+static int interpret(struct Jit* jit, struct MachineState* state) {
+    if (state->PC >= FIRST_UNTRANSLATABLE_ADDRESS) {
+        // Fetching this instruction has side effects, so it can't be inspected before execution
+        int cycles = step(state);
+        flushJit(jit);
+        return cycles;
+    }
+
+    struct DecodedInstruction instruction = getDecodedInstruction(state, state->PC);
+    int cycles = step(state);
+
+    if (instruction.opcode == 4 && jit->constantCodeCounts[instruction.argument] != 0) { // ST
+        discardBlocks(jit, instruction.argument);
+    }
+
+    return cycles;
+}
+
+unsigned long runJit(struct MachineState* state, void* context, unsigned long cycleBudget) {
+    struct Jit* jit = context;
+    long remainingCycles = cycleBudget;
+
+    while (remainingCycles > 0 && state->haltReason == HaltReasonNone) {
+        // Like the other engines, the budget is only exceeded by the last instruction
+        if (remainingCycles < MAX_BLOCK_CYCLES) {
+            remainingCycles -= interpret(jit, state);
+            continue;
+        }
+
+        void* block = jit->blocks[state->PC];
+
+        if (block == NULL) {
+            block = compileBlock(jit, state, state->PC);
+        }
+
+        if (block == NULL) {
+            remainingCycles -= interpret(jit, state);
+            continue;
+        }
+
+        int exit = jit->enter(state, jit, remainingCycles, block);
+        state->cycleCount += remainingCycles - jit->remainingCycles; // read by interpreted instructions in virtual time
+        remainingCycles = jit->remainingCycles;
+
+        if (exit == JitExitInterpret) {
+            remainingCycles -= interpret(jit, state);
+        } else if (exit & JitExitInvalidate) {
+            discardBlocks(jit, exit >> 2);
+        }
+    }
+
+    return cycleBudget - remainingCycles;
+}
+
+#else
+
+void* createJit() {
+    return NULL;
+}
+
+void destroyJit(void* jit) {}
+
+unsigned long runJit(struct MachineState* state, void* jit, unsigned long cycleBudget) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef jit_engine
+#define jit_engine
+
+#include "../machine-state/machine-state.h"
+
+// Returns NULL if native code can't be generated on this host
+void* createJit();
+
+void destroyJit(void* jit);
+
+// Has the same semantics as repeatedly calling step(), but executes basic blocks translated to x86-64 machine code
+unsigned long runJit(struct MachineState* state, void* jit, unsigned long cycleBudget);
+
+#endif
@@ -2,16 +2,37 @@
 #include <stdio.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
 #include <pthread.h> // POSIX
 #include <termios.h> // POSIX
 #include <unistd.h> // POSIX
+#include <poll.h> // POSIX
+#include <time.h> // POSIX
+#include "../time/time.h"
 
-static pthread_t thread;
-static pthread_mutex_t lock;
-static volatile char ch = 0;
-static volatile bool active = false;
+#define FULL_QUEUE_POLL_INTERVAL_US 1000
 
-static void* readChar(void* _) {
+static void pushChar(struct KeyboardInput* input, char ch) {
+    unsigned int tail = atomic_load_explicit(&input->queueTail, memory_order_relaxed);
+
+    while (tail - atomic_load_explicit(&input->queueHead, memory_order_acquire) == INPUT_QUEUE_SIZE) {
+        if (input->backpressure == InputBackpressureDrop || !atomic_load(&input->active)) return;
+        usleep(FULL_QUEUE_POLL_INTERVAL_US);
+    }
+
+    input->queue[tail % INPUT_QUEUE_SIZE] = ch;
+    atomic_store(&input->queueTail, tail + 1);
+
+    if (atomic_load(&input->isWaiting)) {
+        pthread_mutex_lock(&input->waitLock);
+        pthread_cond_signal(&input->inputArrived);
+        pthread_mutex_unlock(&input->waitLock);
+    }
+}
+
+static void* readChar(void* context) {
+    struct KeyboardInput* input = context;
     int readChar = 0;
 
     do {
@@ -20,16 +41,18 @@ static void* readChar(void* _) {
         if (readChar < 0) {
             clearerr(stdin);
         } else {
-            pthread_mutex_lock(&lock);
-            ch = readChar;
-            pthread_mutex_unlock(&lock);
+            pushChar(input, readChar);
         }
-    } while (active);
+    } while (atomic_load(&input->active));
 
     return NULL;
 }
 
-void startAsyncCharacterInput() {
+struct KeyboardInput getKeyboardInput(enum InputBackpressure backpressure) {
+    return (struct KeyboardInput) { .backpressure = backpressure, .fileDescriptor = -1 };
+}
+
+void startAsyncCharacterInput(struct KeyboardInput* input) {
     struct termios attr;
 
     tcgetattr(STDIN_FILENO, &attr);
@@ -39,13 +62,20 @@ void startAsyncCharacterInput() {
     attr.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSANOW, &attr);
 
-    active = true;
+    atomic_store(&input->active, true);
+
+    pthread_condattr_t conditionAttributes;
+    pthread_condattr_init(&conditionAttributes);
+    pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC); // the clock of getTimeNs()
+    pthread_cond_init(&input->inputArrived, &conditionAttributes);
+    pthread_condattr_destroy(&conditionAttributes);
+    pthread_mutex_init(&input->waitLock, NULL);
 
-    pthread_create(&thread, NULL, readChar, NULL);
+    pthread_create(&input->thread, NULL, readChar, input);
 }
 
-void endAsyncCharacterInput() {
-    active = false;
+void endAsyncCharacterInput(struct KeyboardInput* input) {
+    atomic_store(&input->active, false);
 
     struct termios attr;
     
@@ -54,7 +84,10 @@ void endAsyncCharacterInput() {
     attr.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSANOW, &attr);
 
-    pthread_join(thread, NULL);
+    pthread_join(input->thread, NULL);
+
+    pthread_cond_destroy(&input->inputArrived);
+    pthread_mutex_destroy(&input->waitLock);
 
     tcgetattr(STDIN_FILENO, &attr);
     attr.c_lflag |= ICANON;
@@ -62,19 +95,115 @@ void endAsyncCharacterInput() {
     tcsetattr(STDIN_FILENO, TCSANOW, &attr);
 }
 
-char getLastChar() {
-    pthread_mutex_lock(&lock);
-    char result = ch;
-    ch = 0;
-    pthread_mutex_unlock(&lock);
-    
-    return result;
+void startFileCharacterInput(struct KeyboardInput* input, FILE* file) {
+    input->fileDescriptor = fileno(file);
+}
+
+// Returns false if no characters are available yet, without waiting for them
+static bool fillInputFileBuffer(struct KeyboardInput* input) {
+    if (input->fileBufferStart < input->fileBufferEnd) return true;
+    if (input->inputEnded) return false;
+
+    struct pollfd descriptor = { input->fileDescriptor, POLLIN, 0 };
+    if (poll(&descriptor, 1, 0) <= 0) return false;
+
+    ssize_t length = read(input->fileDescriptor, input->fileBuffer, INPUT_FILE_BUFFER_SIZE);
+    if (length <= 0) {
+        input->inputEnded = true;
+        return false;
+    }
+
+    input->fileBufferStart = 0;
+    input->fileBufferEnd = length;
+    return true;
+}
+
+bool hasInputEnded(struct KeyboardInput* input) {
+    return input->inputEnded;
+}
+
+void waitForInput(struct KeyboardInput* input, unsigned long long deadlineNs) {
+    unsigned long long now = getTimeNs();
+    if (now >= deadlineNs) return;
+
+    if (input->fileDescriptor >= 0) {
+        if (input->fileBufferStart < input->fileBufferEnd || input->inputEnded) return;
+
+        struct pollfd descriptor = { input->fileDescriptor, POLLIN, 0 };
+        poll(&descriptor, 1, (deadlineNs - now + 999999) / 1000000);
+        return;
+    }
+
+    struct timespec deadline = { deadlineNs / 1000000000ull, deadlineNs % 1000000000ull };
+
+    pthread_mutex_lock(&input->waitLock);
+    atomic_store(&input->isWaiting, true);
+
+    // The reader thread signals only after it sees isWaiting, so the queue is checked again after setting it
+    while (atomic_load(&input->queueHead) == atomic_load(&input->queueTail)) {
+        if (pthread_cond_timedwait(&input->inputArrived, &input->waitLock, &deadline) != 0) break;
+    }
+
+    atomic_store(&input->isWaiting, false);
+    pthread_mutex_unlock(&input->waitLock);
 }
 
-char peekLastChar() {
-    pthread_mutex_lock(&lock);
-    char result = ch;
-    pthread_mutex_unlock(&lock);
+int getPendingInput(struct KeyboardInput* input, char* buffer) {
+    if (input->fileDescriptor >= 0) {
+        int length = input->fileBufferEnd - input->fileBufferStart;
+        memcpy(buffer, input->fileBuffer + input->fileBufferStart, length);
+        return length;
+    }
+
+    unsigned int head = atomic_load(&input->queueHead);
+    unsigned int tail = atomic_load(&input->queueTail);
+    for (unsigned int i = head; i != tail; ++i) buffer[i - head] = input->queue[i % INPUT_QUEUE_SIZE];
+    return tail - head;
+}
+
+// Whichever input is started reads its own copy of the characters
+void setPendingInput(struct KeyboardInput* input, const char* characters, int length) {
+    memcpy(input->fileBuffer, characters, length);
+    input->fileBufferStart = 0;
+    input->fileBufferEnd = length;
+
+    int queueLength = length < INPUT_QUEUE_SIZE ? length : INPUT_QUEUE_SIZE;
+    memcpy(input->queue, characters, queueLength);
+    atomic_store(&input->queueHead, 0);
+    atomic_store(&input->queueTail, queueLength);
+}
+
+static char readFromSource(struct KeyboardInput* input, bool isPeeking) {
+    int result = input->readSource(input->sourceContext, isPeeking);
+    if (result == INPUT_ENDED && !isPeeking) input->inputEnded = true;
+    return result < 0 ? 0 : result;
+}
+
+char getLastChar(struct KeyboardInput* input) {
+    if (input->readSource != NULL) return readFromSource(input, false);
+
+    if (input->fileDescriptor >= 0) {
+        return fillInputFileBuffer(input) ? input->fileBuffer[input->fileBufferStart++] : 0;
+    }
+
+    unsigned int head = atomic_load_explicit(&input->queueHead, memory_order_relaxed);
+    if (head == atomic_load_explicit(&input->queueTail, memory_order_acquire)) return 0;
+
+    char result = input->queue[head % INPUT_QUEUE_SIZE];
+    atomic_store_explicit(&input->queueHead, head + 1, memory_order_release);
 
     return result;
-}
\ No newline at end of file
+}
+
+char peekLastChar(struct KeyboardInput* input) {
+    if (input->readSource != NULL) return readFromSource(input, true);
+
+    if (input->fileDescriptor >= 0) {
+        return fillInputFileBuffer(input) ? input->fileBuffer[input->fileBufferStart] : 0;
+    }
+
+    unsigned int head = atomic_load_explicit(&input->queueHead, memory_order_relaxed);
+    if (head == atomic_load_explicit(&input->queueTail, memory_order_acquire)) return 0;
+
+    return input->queue[head % INPUT_QUEUE_SIZE];
+}
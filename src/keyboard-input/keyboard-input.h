@@ -1,12 +1,76 @@
 #ifndef keyboard_input
 #define keyboard_input
 
-void startAsyncCharacterInput();
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h> // POSIX
 
-void endAsyncCharacterInput();
+#define INPUT_QUEUE_SIZE 256 // must be a power of 2
+#define INPUT_FILE_BUFFER_SIZE 0x1000
+#define INPUT_NONE (-1) // returned by an input source when no character is available
+#define INPUT_ENDED (-2) // returned by an input source after its last character
 
-char getLastChar();
+// What the reader thread does with a character when the input queue is full
+enum InputBackpressure {
+    InputBackpressureBlock, // waits until the program reads a character
+    InputBackpressureDrop // discards the character
+};
 
-char peekLastChar();
+struct KeyboardInput {
+    enum InputBackpressure backpressure;
 
-#endif
\ No newline at end of file
+    // Single-producer, single-consumer ring buffer between the reader thread and the simulation thread
+    char queue[INPUT_QUEUE_SIZE];
+    atomic_uint queueHead; // index of the oldest character, only written by the simulation thread
+    atomic_uint queueTail; // index past the newest character, only written by the reader thread
+    pthread_t thread;
+    atomic_bool active;
+    atomic_bool isWaiting; // the simulation thread waits for inputArrived
+    pthread_mutex_t waitLock;
+    pthread_cond_t inputArrived;
+
+    // Used instead of the queue if it's not negative
+    int fileDescriptor;
+    char fileBuffer[INPUT_FILE_BUFFER_SIZE];
+    int fileBufferStart;
+    int fileBufferEnd;
+    bool inputEnded;
+
+    // Used instead of the queue and the file if not NULL. Returns the oldest character, INPUT_NONE, or INPUT_ENDED, and
+    // removes the character unless peeking.
+    int (*readSource)(void* context, bool isPeeking);
+    void* sourceContext;
+};
+
+struct KeyboardInput getKeyboardInput(enum InputBackpressure backpressure);
+
+// Configures the terminal and starts a thread reading the standard input. Only one keyboard input can be started at a time.
+void startAsyncCharacterInput(struct KeyboardInput* input);
+
+void endAsyncCharacterInput(struct KeyboardInput* input);
+
+// Reads characters from the file or pipe when the program asks for them, without a reader thread or terminal configuration
+void startFileCharacterInput(struct KeyboardInput* input, FILE* file);
+
+// Returns true if the whole input file was read and the program asked for another character
+bool hasInputEnded(struct KeyboardInput* input);
+
+// Returns when a character can be read or at the deadline (in getTimeNs() time)
+void waitForInput(struct KeyboardInput* input, unsigned long long deadlineNs);
+
+// Copies characters read from the terminal or file which the program hasn't read yet to the buffer, which must fit
+// INPUT_FILE_BUFFER_SIZE characters, and returns their count
+int getPendingInput(struct KeyboardInput* input, char* buffer);
+
+// Makes the program read the characters before any others. Must be called before starting the input, and fits up to
+// INPUT_QUEUE_SIZE characters typed in the terminal or INPUT_FILE_BUFFER_SIZE characters of a file.
+void setPendingInput(struct KeyboardInput* input, const char* characters, int length);
+
+// Removes and returns the oldest queued character, or 0 if the queue is empty
+char getLastChar(struct KeyboardInput* input);
+
+// Returns the oldest queued character without removing it, or 0 if the queue is empty
+char peekLastChar(struct KeyboardInput* input);
+
+#endif
@@ -0,0 +1,239 @@
+#include "libw13.h"
+#include "../machine-state/machine-state.h"
+#include "../keyboard-input/keyboard-input.h"
+#include "../terminal-output/terminal-output.h"
+#include "../engine/engine.h"
+#include "../jit-engine/jit-engine.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define RUN_BATCH_CYCLES 0x40000000 // the JIT engine counts cycles in a long
+
+struct w13_machine {
+    struct MachineState state;
+    struct KeyboardInput keyboardInput;
+    struct TerminalOutput terminalOutput;
+    enum w13_engine engineType;
+    struct Engine engine;
+
+    w13_input_callback inputCallback; // the input buffer is used if NULL
+    void* inputContext;
+    char* input;
+    size_t inputLength;
+    size_t inputPosition; // of the oldest character the program hasn't read
+    bool hasInputEnded;
+
+    w13_output_callback outputCallback; // the output buffer is used if NULL
+    void* outputContext;
+    char* output;
+    size_t outputLength;
+    size_t outputCapacity;
+};
+
+static int readInput(void* context, bool isPeeking) {
+    struct w13_machine* machine = context;
+
+    if (machine->inputCallback != NULL) {
+        int result = machine->inputCallback(machine->inputContext, isPeeking);
+        if (result == W13_END_OF_INPUT) return INPUT_ENDED;
+        return result < 0 ? INPUT_NONE : result & 0xff;
+    }
+
+    if (machine->inputPosition == machine->inputLength) return machine->hasInputEnded ? INPUT_ENDED : INPUT_NONE;
+
+    unsigned char character = machine->input[machine->inputPosition];
+    if (!isPeeking) ++machine->inputPosition;
+    return character;
+}
+
+// Output that doesn't fit in the buffer when it can't grow is discarded
+static void writeOutput(void* context, const char* characters, int length) {
+    struct w13_machine* machine = context;
+
+    if (machine->outputCallback != NULL) {
+        machine->outputCallback(machine->outputContext, characters, length);
+        return;
+    }
+
+    if (machine->outputLength + length > machine->outputCapacity) {
+        size_t capacity = machine->outputCapacity == 0 ? OUTPUT_BUFFER_SIZE : machine->outputCapacity;
+        while (capacity < machine->outputLength + length) capacity *= 2;
+
+        char* output = realloc(machine->output, capacity);
+        if (output == NULL) return;
+
+        machine->output = output;
+        machine->outputCapacity = capacity;
+    }
+
+    memcpy(machine->output + machine->outputLength, characters, length);
+    machine->outputLength += length;
+}
+
+// Unlike createEngine(), falls back to the threaded engine without a warning
+static struct Engine createMachineEngine(enum w13_engine engineType) {
+    switch (engineType) {
+        case W13_ENGINE_THREADED: return createEngine(EngineTypeThreaded);
+        case W13_ENGINE_CYCLE: return createEngine(EngineTypeCycle);
+        case W13_ENGINE_JIT:
+            void* jit = createJit();
+            return jit != NULL ? (struct Engine) { runJit, jit } : createEngine(EngineTypeThreaded);
+        default: return createEngine(EngineTypeSwitch);
+    }
+}
+
+w13_machine* w13_create(enum w13_engine engine) {
+    struct w13_machine* machine = calloc(1, sizeof(struct w13_machine));
+    if (machine == NULL) return NULL;
+
+    machine->state = getInitialState();
+    machine->keyboardInput = getKeyboardInput(InputBackpressureBlock);
+    machine->terminalOutput = getTerminalOutput(OutputBufferPolicyFull, NULL);
+    machine->engineType = engine;
+    machine->engine = createMachineEngine(engine);
+
+    machine->keyboardInput.readSource = readInput;
+    machine->keyboardInput.sourceContext = machine;
+    machine->terminalOutput.write = writeOutput;
+    machine->terminalOutput.writeContext = machine;
+
+    // The clock register holds the measured time minus the start time
+    machine->state.keyboardInput = &machine->keyboardInput;
+    machine->state.terminalOutput = &machine->terminalOutput;
+    machine->state.simulationStartTimeMs = 0;
+    machine->state.simulationMeasuredTimeMs = 0;
+    machine->state.isTimeVirtual = true;
+    machine->state.clockFrequencyKiloHz = 1;
+
+    return machine;
+}
+
+void w13_destroy(w13_machine* machine) {
+    destroyEngine(&machine->engine);
+    free(machine->input);
+    free(machine->output);
+    free(machine);
+}
+
+enum w13_exit_reason w13_run(w13_machine* machine, unsigned long long max_cycles) {
+    struct MachineState* state = &machine->state;
+    unsigned long long endCycleCount = max_cycles < ULLONG_MAX - state->cycleCount ? state->cycleCount + max_cycles : ULLONG_MAX;
+
+    state->haltReason = HaltReasonNone;
+
+    while (state->cycleCount < endCycleCount && state->haltReason == HaltReasonNone) {
+        unsigned long long remainingCycles = endCycleCount - state->cycleCount;
+        machine->engine.run(state, machine->engine.context, remainingCycles < RUN_BATCH_CYCLES ? remainingCycles : RUN_BATCH_CYCLES);
+    }
+
+    flushOutput(&machine->terminalOutput);
+
+    switch (state->haltReason) {
+        case HaltReasonInfiniteLoop: return W13_EXIT_HALT;
+        case HaltReasonEndOfInput: return W13_EXIT_END_OF_INPUT;
+        default: return W13_EXIT_CYCLE_LIMIT;
+    }
+}
+
+bool w13_load(w13_machine* machine, unsigned short address, const void* data, size_t length) {
+    if (address > W13_MEMORY_SIZE || length > (size_t) W13_MEMORY_SIZE - address) return false;
+
+    memcpy(machine->state.memory + address, data, length);
+    invalidateDecodedInstructions(&machine->state);
+
+    // Compiled code may be stale
+    if (machine->engine.run == runJit) {
+        destroyEngine(&machine->engine);
+        machine->engine = createMachineEngine(machine->engineType);
+    }
+
+    return true;
+}
+
+bool w13_peek(w13_machine* machine, unsigned short address, void* buffer, size_t length) {
+    if (address > W13_MEMORY_SIZE || length > (size_t) W13_MEMORY_SIZE - address) return false;
+
+    unsigned char* bytes = buffer;
+    for (size_t i = 0; i < length; ++i) bytes[i] = peekMemory(&machine->state, address + i);
+
+    return true;
+}
+
+unsigned short w13_get_pc(w13_machine* machine) {
+    return machine->state.PC;
+}
+
+unsigned char w13_get_a(w13_machine* machine) {
+    return machine->state.A;
+}
+
+void w13_set_pc(w13_machine* machine, unsigned short pc) {
+    machine->state.PC = pc % W13_MEMORY_SIZE;
+}
+
+void w13_set_a(w13_machine* machine, unsigned char a) {
+    machine->state.A = a;
+}
+
+unsigned long long w13_get_cycle_count(w13_machine* machine) {
+    return machine->state.cycleCount;
+}
+
+bool w13_append_input(w13_machine* machine, const char* characters, size_t length) {
+    // Characters the program has read are dropped
+    size_t pendingLength = machine->inputLength - machine->inputPosition;
+
+    if (pendingLength != 0) memmove(machine->input, machine->input + machine->inputPosition, pendingLength);
+    machine->inputLength = pendingLength;
+    machine->inputPosition = 0;
+
+    if (length != 0) {
+        char* input = realloc(machine->input, pendingLength + length);
+        if (input == NULL) return false;
+
+        memcpy(input + pendingLength, characters, length);
+        machine->input = input;
+    }
+
+    machine->inputLength = pendingLength + length;
+    machine->hasInputEnded = false;
+    machine->keyboardInput.inputEnded = false;
+    return true;
+}
+
+void w13_end_input(w13_machine* machine) {
+    machine->hasInputEnded = true;
+}
+
+size_t w13_read_output(w13_machine* machine, char* buffer, size_t capacity) {
+    size_t length = machine->outputLength < capacity ? machine->outputLength : capacity;
+    if (length == 0) return 0;
+
+    memcpy(buffer, machine->output, length);
+    memmove(machine->output, machine->output + length, machine->outputLength - length);
+    machine->outputLength -= length;
+
+    return length;
+}
+
+void w13_set_input_callback(w13_machine* machine, w13_input_callback callback, void* context) {
+    machine->inputCallback = callback;
+    machine->inputContext = context;
+    machine->keyboardInput.inputEnded = false;
+}
+
+void w13_set_output_callback(w13_machine* machine, w13_output_callback callback, void* context) {
+    flushOutput(&machine->terminalOutput);
+    machine->outputCallback = callback;
+    machine->outputContext = context;
+}
+
+void w13_set_clock_frequency(w13_machine* machine, int kilohertz) {
+    if (kilohertz > 0) machine->state.clockFrequencyKiloHz = kilohertz;
+}
+
+void w13_set_time_callback(w13_machine* machine, w13_time_callback callback, void* context) {
+    machine->state.measureTime = callback;
+    machine->state.measureTimeContext = context;
+}
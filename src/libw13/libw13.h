@@ -0,0 +1,92 @@
+#ifndef libw13_h
+#define libw13_h
+
+// Embeddable W13 simulator. Every machine is independent and the library has no global state, so many machines can run
+// on many threads, as long as each one is used by one thread at a time.
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// The shared library is built with hidden visibility, so only the API is exported to the host
+#if defined(__GNUC__)
+#define W13_API __attribute__((visibility("default")))
+#else
+#define W13_API
+#endif
+
+#define W13_MEMORY_SIZE 0x2000
+#define W13_NO_INPUT (-1) // returned by an input callback when no character is available, the program reads 0
+#define W13_END_OF_INPUT (-2) // returned by an input callback after the last character, reading it ends the run
+
+typedef struct w13_machine w13_machine;
+
+enum w13_engine {
+    W13_ENGINE_SWITCH,
+    W13_ENGINE_THREADED,
+    W13_ENGINE_JIT, // the threaded engine is used instead on hosts other than x86-64
+    W13_ENGINE_CYCLE // simulates every clock cycle of the microarchitecture
+};
+
+enum w13_exit_reason {
+    W13_EXIT_CYCLE_LIMIT, // the clock cycles given to w13_run() elapsed, the machine can continue running
+    W13_EXIT_HALT, // a JMP instruction to its own address was executed
+    W13_EXIT_END_OF_INPUT // the program read the terminal I/O register after the input ended
+};
+
+// Returns the oldest input character, W13_NO_INPUT, or W13_END_OF_INPUT, and removes the character unless peeking, which
+// happens without the program reading the register
+typedef int (*w13_input_callback)(void* context, bool is_peeking);
+
+// Receives characters the program stored to the terminal I/O register
+typedef void (*w13_output_callback)(void* context, const char* characters, size_t length);
+
+// Returns the number of milliseconds the clock register holds when the program reads it after the number of clock cycles
+typedef unsigned long (*w13_time_callback)(void* context, unsigned long long cycle_count);
+
+// Creates a machine with zeroed memory and registers. Input is read from a buffer filled with w13_append_input(), output is
+// collected in a buffer emptied with w13_read_output(), and the clock register counts the milliseconds of simulated clock
+// cycles at 1 kHz. Returns NULL if memory can't be allocated.
+W13_API w13_machine* w13_create(enum w13_engine engine);
+
+W13_API void w13_destroy(w13_machine* machine);
+
+// Runs the program until max_cycles clock cycles elapse, or the program halts. Every engine stops after the same instruction,
+// which may end up to 3 cycles past the limit, so machines reach the same state regardless of the engine.
+W13_API enum w13_exit_reason w13_run(w13_machine* machine, unsigned long long max_cycles);
+
+// Copies the data to memory at the address. Returns false if it doesn't fit.
+W13_API bool w13_load(w13_machine* machine, unsigned short address, const void* data, size_t length);
+
+// Copies memory from the address to the buffer, with the values of memory-mapped registers, without side effects. Returns
+// false if the range exceeds memory.
+W13_API bool w13_peek(w13_machine* machine, unsigned short address, void* buffer, size_t length);
+
+W13_API unsigned short w13_get_pc(w13_machine* machine);
+W13_API unsigned char w13_get_a(w13_machine* machine);
+W13_API void w13_set_pc(w13_machine* machine, unsigned short pc);
+W13_API void w13_set_a(w13_machine* machine, unsigned char a);
+W13_API unsigned long long w13_get_cycle_count(w13_machine* machine);
+
+// Queues characters for the program to read from the terminal I/O register. Returns false if memory can't be allocated.
+W13_API bool w13_append_input(w13_machine* machine, const char* characters, size_t length);
+
+// Makes reading the terminal I/O register after the queued characters end the run with W13_EXIT_END_OF_INPUT
+W13_API void w13_end_input(w13_machine* machine);
+
+// Moves up to capacity characters of the collected output to the buffer, and returns their count
+W13_API size_t w13_read_output(w13_machine* machine, char* buffer, size_t capacity);
+
+// Replaces the input buffer with the callback, or restores it if the callback is NULL
+W13_API void w13_set_input_callback(w13_machine* machine, w13_input_callback callback, void* context);
+
+// Replaces the output buffer with the callback, or restores it if the callback is NULL. Output is passed to the callback
+// when the program reads the terminal I/O or clock register, and at the end of w13_run().
+W13_API void w13_set_output_callback(w13_machine* machine, w13_output_callback callback, void* context);
+
+// Sets the frequency of the simulated clock, which the clock register counts unless a time callback is set
+W13_API void w13_set_clock_frequency(w13_machine* machine, int kilohertz);
+
+// Replaces the simulated time of the clock register with the callback, or restores it if the callback is NULL
+W13_API void w13_set_time_callback(w13_machine* machine, w13_time_callback callback, void* context);
+
+#endif
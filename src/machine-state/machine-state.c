@@ -1,29 +1,55 @@
 #include "machine-state.h"
 #include "../keyboard-input/keyboard-input.h"
 #include "../time/time.h"
+#include "../terminal-output/terminal-output.h"
+#include "../trace/trace.h"
+#include "../history/history.h"
+#include <string.h>
 #include <stdio.h>
-#include <unistd.h> // POSIX
 
 struct MachineState getInitialState()
 {
     unsigned long now = getTimeMs();
-    return (struct MachineState) { false, { 0 }, 0, 0, now, now, 0, 0 };
+    return (struct MachineState) { HaltReasonNone, { 0 }, 0, 0, now, now, 0, 0, 0 };
 }
 
-unsigned short peekInstruction(struct MachineState* state, unsigned short address) {
-    return peekMemory(state, address) | (peekMemory(state, address + 1) << 8);
-}
+bool loadProgram(struct MachineState* state, const char* binaryFilePath) {
+    FILE* binaryFile = fopen(binaryFilePath, "rb");
+
+    if (binaryFile == NULL) {
+        printf("Error: could not read file \"%s\".\n", binaryFilePath);
+        return false;
+    }
 
-unsigned short getInstruction(struct MachineState* state, unsigned short address) {
-    return getMemory(state, address) | (getMemory(state, address + 1) << 8);
+    fseek(binaryFile, 0, SEEK_END);
+    int programLength = ftell(binaryFile);
+
+    if (programLength > 0x1FFF) {
+        printf("Error: The binary file size is invalid, should be less than 8192 bytes.\n");
+        fclose(binaryFile);
+        return false;
+    }
+
+    fseek(binaryFile, 0, SEEK_SET);
+    fread(state->memory, sizeof(unsigned char), programLength, binaryFile);
+    fclose(binaryFile);
+
+    invalidateDecodedInstructions(state);
+
+    return true;
 }
 
-unsigned char peekMemory(struct MachineState* state, unsigned short address) {
-    address %= 0x2000; 
+unsigned long measureTimeMs(struct MachineState* state, unsigned long long cycleCount) {
+    if (state->measureTime != NULL) return state->measureTime(state->measureTimeContext, cycleCount);
+    if (!state->isTimeVirtual) return getTimeMs();
 
+    return state->simulationStartTimeMs + state->simulationIdleTimeMs + cycleCount / state->clockFrequencyKiloHz;
+}
+
+unsigned char peekMemoryMappedRegister(struct MachineState* state, unsigned short address) {
     switch (address) {
         case IO_INTERFACE_ADDRESS:
-            return peekLastChar();
+            return peekLastChar(state->keyboardInput);
         case TIME_INTERFACE_ADDRESS:
         case TIME_INTERFACE_ADDRESS + 1:
         case TIME_INTERFACE_ADDRESS + 2:
@@ -36,51 +62,112 @@ unsigned char peekMemory(struct MachineState* state, unsigned short address) {
     }
 }
 
-unsigned char getMemory(struct MachineState* state, unsigned short address) {
+unsigned char getMemoryMappedRegister(struct MachineState* state, unsigned short address) {
+    if (state->traceReader != NULL) return replayRegisterRead(state->traceReader, state, address);
+    if (state->history != NULL && isReplayingHistory(state->history)) return replayHistoryRegisterRead(state->history);
+
+    unsigned char value;
+
     switch (address) {
         case IO_INTERFACE_ADDRESS:
-            return getLastChar();
+            flushOutput(state->terminalOutput); // the program may wait for input in response to its output
+            value = getLastChar(state->keyboardInput);
+            if (value == 0 && hasInputEnded(state->keyboardInput)) state->haltReason = HaltReasonEndOfInput;
+            break;
         case TIME_INTERFACE_ADDRESS:
-            state->simulationMeasuredTimeMs = getTimeMs();
+            flushOutput(state->terminalOutput);
+            state->simulationMeasuredTimeMs = measureTimeMs(state, state->cycleCount);
         default:
-            return peekMemory(state, address);
+            value = peekMemoryMappedRegister(state, address);
     }
+
+    if (state->traceWriter != NULL) traceRegisterRead(state->traceWriter, address, value, state->haltReason == HaltReasonEndOfInput);
+    if (state->history != NULL) recordHistoryRegisterRead(state->history, value);
+
+    return value;
 }
 
-void step(struct MachineState* state)
-{
-    unsigned short instruction = getInstruction(state, state->PC);
+void invalidateDecodedInstructions(struct MachineState* state) {
+    memset(state->decodedInstructions, 0, sizeof(state->decodedInstructions));
+}
+
+static struct DecodedInstruction decodeInstruction(unsigned short instruction) {
     unsigned char opcode = instruction >> 13;
-    unsigned short argument = instruction & 0x1fff;
-    unsigned char memoryAtArgument = getMemory(state, argument);
 
-    switch (opcode) {
+    return (struct DecodedInstruction) {
+        instruction & 0x1fff,
+        opcode,
+        opcode >= 5 ? 3 : 4 // JMP, JMN, and JMZ take 3 clock cycles
+    };
+}
+
+struct DecodedInstruction decodeInstructionAt(struct MachineState* state, unsigned short address) {
+    // Instructions overlapping memory-mapped registers are fetched every time, because fetching them has side effects
+    if (address >= TIME_INTERFACE_ADDRESS - 1) return decodeInstruction(getInstruction(state, address));
+
+    struct DecodedInstruction decoded = decodeInstruction(peekInstruction(state, address));
+    state->decodedInstructions[address] = decoded;
+    return decoded;
+}
+
+void findReachableInstructions(struct MachineState* state, bool* reachable, bool* entryPoints) {
+    unsigned short worklist[ADDRESS_SPACE_SIZE];
+    int worklistLength = 0;
+
+    reachable[0] = true;
+    entryPoints[0] = true;
+    worklist[worklistLength++] = 0;
+
+    while (worklistLength > 0) {
+        unsigned short address = worklist[--worklistLength];
+        unsigned short instruction = peekInstruction(state, address);
+        unsigned char opcode = instruction >> 13;
+        unsigned short argument = instruction & 0x1fff;
+
+        // Code following a JMP is reachable if the JMP is a subroutine call, whose return jump is patched by the caller
+        bool isHalt = opcode == 5 && argument == address;
+        unsigned short successors[2] = { isHalt ? address : address + 2, opcode >= 5 ? argument : address + 2 };
+
+        for (int i = 0; i < 2; ++i) {
+            if (successors[i] >= TIME_INTERFACE_ADDRESS - 1) continue;
+            if (opcode == 5 || (i == 1 && opcode > 5)) entryPoints[successors[i]] = true;
+            if (!reachable[successors[i]]) {
+                reachable[successors[i]] = true;
+                worklist[worklistLength++] = successors[i];
+            }
+        }
+    }
+}
+
+int step(struct MachineState* state)
+{
+    struct DecodedInstruction instruction = getDecodedInstruction(state, state->PC);
+    unsigned short argument = instruction.argument;
+
+    switch (instruction.opcode) {
         case 0: // LD
-            state->A = memoryAtArgument;
+            state->A = getMemory(state, argument);
             state->PC += 2;
             break;
         case 1: // NOT
-            state->A = ~memoryAtArgument;
+            state->A = ~getMemory(state, argument);
             state->PC += 2;
             break;
         case 2: // ADD
-            state->A = state->A + memoryAtArgument;
+            state->A = state->A + getMemory(state, argument);
             state->PC += 2;
             break;
         case 3: // AND
-            state->A = state->A & memoryAtArgument;
+            state->A = state->A & getMemory(state, argument);
             state->PC += 2;
             break;
         case 4: // ST
-            if (argument == IO_INTERFACE_ADDRESS) {
-                putchar(state->A);
-                fflush(stdout);
-            }
-            else state->memory[argument] = state->A;
+            if (argument == IO_INTERFACE_ADDRESS) putOutputChar(state->terminalOutput, state->A);
+            else setMemory(state, argument, state->A);
             state->PC += 2;
             break;
         case 5: // JMP
-            if (state->PC == argument) state->isUnconditionalInfiniteLoop = true;
+            if (state->PC == argument) state->haltReason = HaltReasonInfiniteLoop;
             else state->PC = argument;
             break;
         case 6: // JMN
@@ -93,8 +180,7 @@ void step(struct MachineState* state)
     
     state->PC %= 0x2000;
 
-    int clockCycles = opcode >= 5 // JMP, JMN, or JMZ
-        ? 3 : 4;
+    state->cycleCount += instruction.clockCycles;
 
-    usleep(state->clockPeriodMicroseconds * clockCycles);
+    return instruction.clockCycles;
 }
@@ -2,32 +2,112 @@
 #define machine_state
 
 #include <stdbool.h>
+#include "../keyboard-input/keyboard-input.h"
+#include "../terminal-output/terminal-output.h"
 
 #define ADDRESS_SPACE_SIZE 0x2000
 #define IO_INTERFACE_ADDRESS 0x1fff
 #define TIME_INTERFACE_ADDRESS 0x1ffb
 
+struct TraceWriter;
+struct TraceReader;
+struct History;
+
+enum HaltReason {
+    HaltReasonNone = 0,
+    HaltReasonInfiniteLoop, // a JMP instruction to the current address was executed
+    HaltReasonEndOfInput, // the program read the I/O register after the whole input file was read
+    HaltReasonCycleLimit,
+    HaltReasonTimeLimit,
+    HaltReasonNonTermination, // the program provably runs forever without I/O
+    HaltReasonInterrupted // ^C was pressed while recording a trace
+};
+
+struct DecodedInstruction {
+    unsigned short argument;
+    unsigned char opcode;
+    unsigned char clockCycles; // 0 if the instruction slot is not decoded
+};
+
 struct MachineState {
-    bool isUnconditionalInfiniteLoop;
+    enum HaltReason haltReason;
     unsigned char memory[ADDRESS_SPACE_SIZE];
     unsigned short PC;
     unsigned char A;
     unsigned long simulationStartTimeMs;
     unsigned long simulationMeasuredTimeMs;
     unsigned long simulationIdleTimeMs;
-    int clockPeriodMicroseconds;
+    unsigned long long cycleCount;
+    int clockFrequencyKiloHz;
+    bool isTimeVirtual; // the clock register counts clock cycles at clockFrequencyKiloHz instead of wall-clock time
+    struct DecodedInstruction decodedInstructions[ADDRESS_SPACE_SIZE]; // instruction starting at each address
+    struct KeyboardInput* keyboardInput;
+    struct TerminalOutput* terminalOutput;
+    struct TraceWriter* traceWriter; // records memory-mapped register reads if not NULL
+    struct TraceReader* traceReader; // supplies recorded values of memory-mapped registers if not NULL
+    struct History* history; // records values of memory-mapped registers, or supplies them when replaying, if not NULL
+    unsigned long (*measureTime)(void* context, unsigned long long cycleCount); // replaces the wall clock and virtual time if not NULL
+    void* measureTimeContext;
 };
 
+// The keyboard input and terminal output must be attached before running the machine
 struct MachineState getInitialState();
 
-unsigned short peekInstruction(struct MachineState* state, unsigned short address);
+// Loads the binary file at the beginning of memory. Prints an error and returns false if it can't be loaded.
+bool loadProgram(struct MachineState* state, const char* binaryFilePath);
+
+// Returns the value of simulationMeasuredTimeMs that reading the clock register at the cycle count would store
+unsigned long measureTimeMs(struct MachineState* state, unsigned long long cycleCount);
+
+// Slow path of peekMemory for addresses of memory-mapped registers
+unsigned char peekMemoryMappedRegister(struct MachineState* state, unsigned short address);
+
+// Slow path of getMemory for addresses of memory-mapped registers, reading them may have side effects
+unsigned char getMemoryMappedRegister(struct MachineState* state, unsigned short address);
+
+// Returns the value at the address without side effects of reading memory-mapped registers
+static inline unsigned char peekMemory(struct MachineState* state, unsigned short address) {
+    address %= ADDRESS_SPACE_SIZE;
+    return address < TIME_INTERFACE_ADDRESS ? state->memory[address] : peekMemoryMappedRegister(state, address);
+}
+
+static inline unsigned char getMemory(struct MachineState* state, unsigned short address) {
+    address %= ADDRESS_SPACE_SIZE;
+    return address < TIME_INTERFACE_ADDRESS ? state->memory[address] : getMemoryMappedRegister(state, address);
+}
+
+static inline unsigned short peekInstruction(struct MachineState* state, unsigned short address) {
+    return peekMemory(state, address) | (peekMemory(state, address + 1) << 8);
+}
+
+static inline unsigned short getInstruction(struct MachineState* state, unsigned short address) {
+    return getMemory(state, address) | (getMemory(state, address + 1) << 8);
+}
+
+// Writes to program memory and invalidates decoded instructions overlapping the address
+static inline void setMemory(struct MachineState* state, unsigned short address, unsigned char value) {
+    address %= ADDRESS_SPACE_SIZE;
+    state->memory[address] = value;
+    state->decodedInstructions[address].clockCycles = 0;
+    state->decodedInstructions[(address + ADDRESS_SPACE_SIZE - 1) % ADDRESS_SPACE_SIZE].clockCycles = 0;
+}
+
+// Must be called after modifying memory directly
+void invalidateDecodedInstructions(struct MachineState* state);
 
-unsigned short getInstruction(struct MachineState* state, unsigned short address);
+struct DecodedInstruction decodeInstructionAt(struct MachineState* state, unsigned short address);
 
-unsigned char peekMemory(struct MachineState* state, unsigned short address);
+static inline struct DecodedInstruction getDecodedInstruction(struct MachineState* state, unsigned short address) {
+    struct DecodedInstruction decoded = state->decodedInstructions[address];
+    return decoded.clockCycles != 0 ? decoded : decodeInstructionAt(state, address);
+}
 
-unsigned char getMemory(struct MachineState* state, unsigned short address);
+// Marks the instructions reachable from address 0 in zero-initialized arrays, by static analysis of the memory. Entry points
+// are the instructions that jumps and interpreters may continue at, other instructions are only reached by falling through.
+// Instructions overlapping memory-mapped registers are never marked.
+void findReachableInstructions(struct MachineState* state, bool* reachable, bool* entryPoints);
 
-void step(struct MachineState* state);
+// Executes one instruction and returns the number of clock cycles it took
+int step(struct MachineState* state);
 
 #endif
\ No newline at end of file
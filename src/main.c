@@ -23,40 +23,188 @@
 #include "machine-state/machine-state.h"
 #include "debug-runtime/debug-runtime.h"
 #include "default-runtime/default-runtime.h"
+#include "c-emitter/c-emitter.h"
+#include "terminal-output/terminal-output.h"
+#include "keyboard-input/keyboard-input.h"
+#include "fleet-runtime/fleet-runtime.h"
+#include "profiler/profiler.h"
+#include "call-graph/call-graph.h"
+#include "symbols/symbols.h"
+#include "trace/trace.h"
+#include "snapshot/snapshot.h"
+#include "engine/engine.h"
+#include "time/time.h"
+#include "perf-counters/perf-counters.h"
+#include "cycle-engine/cycle-engine.h"
+#include <stdlib.h>
+
+static int getExitStatus(enum HaltReason haltReason) {
+    switch (haltReason) {
+        case HaltReasonEndOfInput: return 2;
+        case HaltReasonCycleLimit: return 3;
+        case HaltReasonTimeLimit: return 4;
+        case HaltReasonNonTermination: return 5;
+        case HaltReasonInterrupted: return 130;
+        default: return 0;
+    }
+}
 
 int main(int argc, const char * argv[]) {
     struct ProgramInput input = getProgramInput(argc, argv);
 
-    FILE* binaryFile = fopen(input.binaryFilePath, "rb");
-
-    if (binaryFile == NULL) {
-        printf("Error: could not read file \"%s\"\n.", input.binaryFilePath);
-        return 1;
+    if (input.fleetFilePath != NULL) {
+        bool success = runFleet(input.fleetFilePath, input.fleetThreadCount, input.engineType, input.clockFrequencyKiloHz, input.virtualTimeMode, input.maxCycles, input.maxTimeMs, input.nonTerminationDetectionMode);
+        return success ? 0 : 1;
     }
 
-    fseek(binaryFile, 0, SEEK_END);
-    int fileSize = ftell(binaryFile);
-    int programLength = fileSize;
+    struct MachineState state = getInitialState();
 
-    if (programLength > 0x1FFF) {
-        printf("Error: The binary file size is invalid, should be less than 8192 bytes.\n");
-        fclose(binaryFile);
-        return 1;
+    if (input.replayFilePath != NULL) {
+        struct TerminalOutput terminalOutput = getTerminalOutput(input.outputBufferPolicy, stdout);
+        state.terminalOutput = &terminalOutput;
+        struct Symbols* symbols = calloc(1, sizeof(struct Symbols));
+        parseSymbolsFile(symbols, input.symbolsFilePath);
+        return replayTrace(&state, input.replayFilePath, symbols) ? getExitStatus(state.haltReason) : 1;
     }
 
-    struct MachineState state = getInitialState();
+    struct KeyboardInput keyboardInput = getKeyboardInput(input.inputBackpressure);
+    struct TerminalOutput terminalOutput = getTerminalOutput(input.outputBufferPolicy, stdout);
 
-    fseek(binaryFile, 0, SEEK_SET);
-    fread(state.memory, sizeof(unsigned char), programLength, binaryFile);
-    fclose(binaryFile);
+    state.keyboardInput = &keyboardInput;
+    state.terminalOutput = &terminalOutput;
+    state.clockFrequencyKiloHz = input.clockFrequencyKiloHz;
+    state.isTimeVirtual = input.virtualTimeMode;
 
-    state.clockPeriodMicroseconds = 1000 / input.clockFrequencyKiloHz;
+    if (input.loadSnapshotFilePath == NULL && !loadProgram(&state, input.binaryFilePath)) return 1;
 
-    if (input.debugMode) {
-        runDebug(&state, (char*) input.symbolsFilePath);
+    if (input.emitCMode) {
+        emitC(&state, input.binaryFilePath, stdout);
+    } else if (input.debugMode) {
+        runDebug(&state, (char*) input.symbolsFilePath, input.loadSnapshotFilePath);
     } else {
-        runDefault(&state);
+        FILE* profileFile = NULL;
+        FILE* callGraphFile = NULL;
+        FILE* cycleTraceFile = NULL;
+        struct Symbols* symbols = NULL;
+
+        if (input.profileFilePath != NULL || input.callGraphFilePath != NULL || input.saveSnapshotFilePath != NULL || input.loadSnapshotFilePath != NULL) {
+            symbols = calloc(1, sizeof(struct Symbols));
+            parseSymbolsFile(symbols, input.symbolsFilePath);
+        }
+
+        // Symbols of the snapshot are kept when it's saved again, unless a symbols file replaces them
+        if (input.loadSnapshotFilePath != NULL && !loadSnapshot(input.loadSnapshotFilePath, &state, NULL, input.symbolsFilePath == NULL ? symbols : NULL)) {
+            return 1;
+        }
+
+        if (input.profileFilePath != NULL) {
+            profileFile = fopen(input.profileFilePath, "w");
+
+            if (profileFile == NULL) {
+                printf("Error: could not write file \"%s\".\n", input.profileFilePath);
+                return 1;
+            }
+        }
+
+        if (input.callGraphFilePath != NULL) {
+            callGraphFile = fopen(input.callGraphFilePath, "w");
+
+            if (callGraphFile == NULL) {
+                printf("Error: could not write file \"%s\".\n", input.callGraphFilePath);
+                return 1;
+            }
+        }
+
+        if (input.cycleTraceFilePath != NULL) {
+            cycleTraceFile = fopen(input.cycleTraceFilePath, "w");
+
+            if (cycleTraceFile == NULL) {
+                printf("Error: could not write file \"%s\".\n", input.cycleTraceFilePath);
+                return 1;
+            }
+        }
+
+        if (input.traceFilePath != NULL) {
+            state.traceWriter = createTraceWriter(input.traceFilePath, &state);
+            if (state.traceWriter == NULL) return 1;
+        }
+
+        struct Engine engine = callGraphFile != NULL
+            ? (struct Engine) { runCallGraph, createCallGraph(symbols) }
+            : state.traceWriter != NULL
+            ? (struct Engine) { runTraced, state.traceWriter }
+            : cycleTraceFile != NULL || input.lockstepMode
+            ? (struct Engine) { runCycleAccurate, createCycleEngine(cycleTraceFile, input.lockstepMode) }
+            : createEngine(input.engineType);
+
+        unsigned long long startCycleCount = state.cycleCount;
+        unsigned long long startTimeNs = getTimeNs();
+        struct PerfCounters* perfCounters = input.perfCountersMode ? startPerfCounters() : NULL;
+
+        if (input.headlessMode) {
+            FILE* inputFile = stdin;
+
+            if (input.inputFilePath != NULL) {
+                inputFile = fopen(input.inputFilePath, "rb");
+
+                if (inputFile == NULL) {
+                    printf("Error: could not read file \"%s\".\n", input.inputFilePath);
+                    return 1;
+                }
+            }
+
+            runDefault(&state, &engine, inputFile, input.maxCycles, input.maxTimeMs, input.nonTerminationDetectionMode);
+
+            if (inputFile != stdin) fclose(inputFile);
+        } else {
+            runDefault(&state, &engine, NULL, input.maxCycles, input.maxTimeMs, input.nonTerminationDetectionMode);
+        }
+
+        if (perfCounters != NULL) stopPerfCounters(perfCounters);
+
+        if (input.statsMode) {
+            // The standard output is the program's
+            double elapsedMs = (getTimeNs() - startTimeNs) / 1e6;
+            unsigned long long cycles = state.cycleCount - startCycleCount;
+            fprintf(stderr, "Statistics: %llu clock cycles in %.3f ms, %.3f million clock cycles per second.\n", cycles, elapsedMs, elapsedMs > 0 ? cycles / elapsedMs / 1e3 : 0);
+        }
+
+        if (perfCounters != NULL) {
+            writePerfCountersReport(perfCounters, getEngineInstructionCount(&engine), state.cycleCount - startCycleCount, stderr);
+            destroyPerfCounters(perfCounters);
+        }
+
+        if (input.saveSnapshotFilePath != NULL) {
+            if (!saveSnapshot(input.saveSnapshotFilePath, &state, NULL, symbols)) return 1;
+        }
+
+        if (callGraphFile != NULL) {
+            writeFoldedStacks(engine.context, callGraphFile);
+            fclose(callGraphFile);
+        }
+
+        if (profileFile != NULL) {
+            if (callGraphFile != NULL) {
+                writeProfileReport(&((struct CallGraph*) engine.context)->profile, &state, symbols, profileFile);
+                writeCallGraphReport(engine.context, profileFile);
+            } else {
+                writeProfileReport(engine.context, &state, symbols, profileFile);
+            }
+
+            fclose(profileFile);
+        }
+
+        if (symbols != NULL) {
+            freeSymbols(symbols);
+            free(symbols);
+        }
+
+        destroyEngine(&engine);
+
+        if (cycleTraceFile != NULL) fclose(cycleTraceFile);
+
+        if (state.traceWriter != NULL && !destroyTraceWriter(state.traceWriter, state.haltReason)) return 1;
     }
 
-    return 0;
+    return getExitStatus(state.haltReason);
 }
\ No newline at end of file
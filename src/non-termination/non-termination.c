@@ -0,0 +1,115 @@
+#include "non-termination.h"
+#include "../machine-state/machine-state.h"
+#include <string.h>
+
+#define OVERHEAD_RATIO 64 // cycles the machine executes per cycle spent probing
+#define MIN_PROBE_INSTRUCTIONS 0x400
+#define MAX_PROBE_INSTRUCTIONS 0x1000000
+#define PROBE_SETUP_CYCLES 0x400 // estimated cost of copying the memory
+
+enum ProbeResult {
+    ProbeResultNonTermination, // a state repeated
+    ProbeResultSideEffect, // the machine accessed a memory-mapped register or halted
+    ProbeResultInconclusive // the instruction limit was reached
+};
+
+// Order-independent, so that the hash of the memory can be updated on every write
+static inline unsigned long long hashMemoryCell(unsigned short address, unsigned char value) {
+    unsigned long long hash = ((address << 8 | value) + 1) * 0x9e3779b97f4a7c15ull;
+    return hash ^ hash >> 29;
+}
+
+// Runs the machine's copy in the detector's memory using Brent's cycle detection on the states at backward jumps. Every
+// loop contains a backward jump, because the PC can only wrap around by fetching from memory-mapped registers.
+static enum ProbeResult probe(struct NonTerminationDetector* detector, struct MachineState* state, unsigned long* instructions) {
+    unsigned char* memory = detector->memory;
+    unsigned short PC = state->PC;
+    unsigned char A = state->A;
+    unsigned long long memoryHash = 0; // XOR of the hashes of cells that differ from the machine's memory
+
+    memcpy(memory, state->memory, ADDRESS_SPACE_SIZE);
+    memcpy(detector->savedMemory, memory, ADDRESS_SPACE_SIZE);
+    unsigned short savedPC = PC;
+    unsigned char savedA = A;
+    unsigned long long savedMemoryHash = memoryHash;
+    unsigned long savePeriod = 1;
+    unsigned long backwardJumps = 0;
+
+    for (*instructions = 0; *instructions < detector->probeInstructions; ++*instructions) {
+        if (PC >= TIME_INTERFACE_ADDRESS - 1) return ProbeResultSideEffect;
+
+        unsigned short instruction = memory[PC] | memory[PC + 1] << 8;
+        unsigned char opcode = instruction >> 13;
+        unsigned short argument = instruction & 0x1fff;
+
+        if (opcode <= 4 && argument >= TIME_INTERFACE_ADDRESS) return ProbeResultSideEffect;
+
+        unsigned short nextPC = (PC + 2) % ADDRESS_SPACE_SIZE;
+
+        switch (opcode) {
+            case 0: A = memory[argument]; break; // LD
+            case 1: A = ~memory[argument]; break; // NOT
+            case 2: A += memory[argument]; break; // ADD
+            case 3: A &= memory[argument]; break; // AND
+            case 4: // ST
+                memoryHash ^= hashMemoryCell(argument, memory[argument]) ^ hashMemoryCell(argument, A);
+                memory[argument] = A;
+                break;
+            case 5: // JMP
+                if (argument == PC) return ProbeResultSideEffect;
+                nextPC = argument;
+                break;
+            case 6: if (A & 0x80) nextPC = argument; break; // JMN
+            case 7: if (A == 0) nextPC = argument; break; // JMZ
+        }
+
+        bool isBackwardJump = nextPC <= PC;
+        PC = nextPC;
+
+        if (!isBackwardJump) continue;
+
+        if (PC == savedPC && A == savedA && memoryHash == savedMemoryHash
+            && memcmp(memory, detector->savedMemory, ADDRESS_SPACE_SIZE) == 0) {
+            return ProbeResultNonTermination;
+        }
+
+        if (++backwardJumps == savePeriod) {
+            savedPC = PC;
+            savedA = A;
+            savedMemoryHash = memoryHash;
+            memcpy(detector->savedMemory, memory, ADDRESS_SPACE_SIZE);
+            savePeriod *= 2;
+            backwardJumps = 0;
+        }
+    }
+
+    return ProbeResultInconclusive;
+}
+
+struct NonTerminationDetector getNonTerminationDetector() {
+    return (struct NonTerminationDetector) { 0, MIN_PROBE_INSTRUCTIONS };
+}
+
+bool detectNonTermination(struct NonTerminationDetector* detector, struct MachineState* state, unsigned long cycles) {
+    detector->creditCycles += cycles;
+
+    if (detector->creditCycles < 0) return false;
+
+    unsigned long instructions;
+    enum ProbeResult result = probe(detector, state, &instructions);
+
+    detector->creditCycles -= (instructions * 4 + PROBE_SETUP_CYCLES) * OVERHEAD_RATIO;
+
+    switch (result) {
+        case ProbeResultNonTermination:
+            return true;
+        case ProbeResultSideEffect:
+            detector->probeInstructions = MIN_PROBE_INSTRUCTIONS;
+            return false;
+        case ProbeResultInconclusive:
+            if (detector->probeInstructions < MAX_PROBE_INSTRUCTIONS) detector->probeInstructions *= 2;
+            return false;
+    }
+
+    return false;
+}
@@ -0,0 +1,20 @@
+#ifndef non_termination
+#define non_termination
+
+#include "../machine-state/machine-state.h"
+#include <stdbool.h>
+
+struct NonTerminationDetector {
+    long long creditCycles; // probes may run while it's not negative, so that they take a small fraction of the run time
+    unsigned long probeInstructions; // limit of the next probe, doubled after every inconclusive probe
+    unsigned char memory[ADDRESS_SPACE_SIZE]; // memory of the probed machine
+    unsigned char savedMemory[ADDRESS_SPACE_SIZE]; // memory of the state later states are compared with
+};
+
+struct NonTerminationDetector getNonTerminationDetector();
+
+// Accounts for the cycles executed by the machine, and from time to time runs a copy of it, looking for a state that repeats
+// without I/O in between. Returns true if the machine provably never halts on its own.
+bool detectNonTermination(struct NonTerminationDetector* detector, struct MachineState* state, unsigned long cycles);
+
+#endif
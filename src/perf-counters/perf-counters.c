@@ -0,0 +1,148 @@
+#include "perf-counters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+static const char* const counterNames[PERF_COUNTER_COUNT] = { "Host cycles", "Host instructions", "Branch misses", "L1D read misses", "Kernel cycles" };
+
+#if defined(__linux__)
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int openCounter(enum PerfCounter counter) {
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (counter) {
+        case PerfCounterCycles: attributes.config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case PerfCounterInstructions: attributes.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case PerfCounterBranchMisses: attributes.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        case PerfCounterL1DReadMisses:
+            attributes.type = PERF_TYPE_HW_CACHE;
+            attributes.config = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+            break;
+        case PerfCounterKernelCycles:
+            attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+            attributes.exclude_kernel = 0;
+            attributes.exclude_user = 1;
+            break;
+    }
+
+    // Only the calling thread is counted, on any CPU
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+struct PerfCounters* startPerfCounters() {
+    struct PerfCounters* counters = calloc(1, sizeof(struct PerfCounters));
+    int openedCount = 0;
+    int firstError = 0;
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        counters->fileDescriptors[i] = openCounter(i);
+
+        if (counters->fileDescriptors[i] >= 0) {
+            ++openedCount;
+        } else if (firstError == 0) {
+            firstError = errno;
+        }
+    }
+
+    if (openedCount == 0) {
+        fprintf(stderr, "Warning: performance counters are not available (%s), they won't be reported.\n", strerror(firstError));
+        free(counters);
+        return NULL;
+    }
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (counters->fileDescriptors[i] >= 0) ioctl(counters->fileDescriptors[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    return counters;
+}
+
+void stopPerfCounters(struct PerfCounters* counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (counters->fileDescriptors[i] >= 0) ioctl(counters->fileDescriptors[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        unsigned long long data[3]; // value, time enabled, time running
+        if (counters->fileDescriptors[i] < 0) continue;
+
+        if (read(counters->fileDescriptors[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            close(counters->fileDescriptors[i]);
+            counters->fileDescriptors[i] = -1;
+            continue;
+        }
+
+        // The kernel shares the hardware counters between events when there aren't enough of them
+        counters->isMultiplexed[i] = data[2] < data[1];
+        counters->values[i] = counters->isMultiplexed[i] ? (unsigned long long) ((double) data[0] * data[1] / data[2]) : data[0];
+    }
+}
+
+void destroyPerfCounters(struct PerfCounters* counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (counters->fileDescriptors[i] >= 0) close(counters->fileDescriptors[i]);
+    }
+
+    free(counters);
+}
+
+#else
+
+struct PerfCounters* startPerfCounters() {
+    fprintf(stderr, "Warning: performance counters are only available on Linux, they won't be reported.\n");
+    return NULL;
+}
+
+void stopPerfCounters(struct PerfCounters* counters) {}
+
+void destroyPerfCounters(struct PerfCounters* counters) {
+    free(counters);
+}
+
+#endif
+
+void writePerfCountersReport(struct PerfCounters* counters, unsigned long long instructionCount, unsigned long long cycleCount, FILE* output) {
+    fprintf(output, "Performance counters of the simulation thread:\n");
+    fprintf(output, "%-18s  %16s  %16s  %16s\n", "", "Count", "Per instruction", "Per clock cycle");
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (counters->fileDescriptors[i] < 0) {
+            fprintf(output, "%-18s  %16s\n", counterNames[i], "not available");
+            continue;
+        }
+
+        unsigned long long value = counters->values[i];
+        fprintf(output, "%-18s  %16llu", counterNames[i], value);
+
+        if (instructionCount != 0) {
+            fprintf(output, "  %16.3f", (double) value / instructionCount);
+        } else {
+            fprintf(output, "  %16s", "-");
+        }
+
+        fprintf(output, "  %16.3f%s\n", cycleCount != 0 ? (double) value / cycleCount : 0, counters->isMultiplexed[i] ? "  (multiplexed)" : "");
+    }
+
+    if (counters->fileDescriptors[PerfCounterCycles] >= 0 && counters->fileDescriptors[PerfCounterInstructions] >= 0 && counters->values[PerfCounterCycles] != 0) {
+        fprintf(output, "%.3f host instructions per host cycle.\n", (double) counters->values[PerfCounterInstructions] / counters->values[PerfCounterCycles]);
+    }
+
+    if (instructionCount == 0) {
+        fprintf(output, "The engine doesn't count simulated instructions, use the switch engine or --profile to normalize per instruction.\n");
+    } else {
+        fprintf(output, "%llu simulated instructions, %llu clock cycles.\n", instructionCount, cycleCount);
+    }
+}
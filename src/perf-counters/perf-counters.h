@@ -0,0 +1,36 @@
+#ifndef perf_counters_h
+#define perf_counters_h
+
+#include <stdio.h>
+#include <stdbool.h>
+
+enum PerfCounter {
+    PerfCounterCycles = 0,
+    PerfCounterInstructions,
+    PerfCounterBranchMisses,
+    PerfCounterL1DReadMisses,
+    PerfCounterKernelCycles // spent in system calls, e.g. writing the output
+};
+
+#define PERF_COUNTER_COUNT 5
+
+// Hardware performance counters of the calling thread, opened with perf_event_open on Linux. The other counters only count
+// in user space, so they are available without privileges unless the kernel or the container forbids performance monitoring.
+struct PerfCounters {
+    int fileDescriptors[PERF_COUNTER_COUNT]; // -1 if the counter isn't available
+    unsigned long long values[PERF_COUNTER_COUNT];
+    bool isMultiplexed[PERF_COUNTER_COUNT]; // the value was scaled from the time the counter was running
+};
+
+// Opens and enables the counters which are available. Prints a warning and returns NULL if none of them are.
+struct PerfCounters* startPerfCounters();
+
+// Disables the counters and reads their values
+void stopPerfCounters(struct PerfCounters* counters);
+
+// Writes the values, and their ratios to the simulated instructions, unless instructionCount is 0, and clock cycles
+void writePerfCountersReport(struct PerfCounters* counters, unsigned long long instructionCount, unsigned long long cycleCount, FILE* output);
+
+void destroyPerfCounters(struct PerfCounters* counters);
+
+#endif
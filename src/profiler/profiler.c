@@ -0,0 +1,104 @@
+#include "profiler.h"
+#include "../machine-state/machine-state.h"
+#include "../symbols/symbols.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define REPORTED_LABELS 20
+#define REPORTED_ADDRESSES 20
+
+struct ProfileEntry {
+    unsigned short address;
+    unsigned long long executions;
+    unsigned long long cycles;
+};
+
+static int compareEntriesByCycles(const void* a, const void* b) {
+    const struct ProfileEntry* entryA = a;
+    const struct ProfileEntry* entryB = b;
+
+    if (entryA->cycles != entryB->cycles) return entryA->cycles < entryB->cycles ? 1 : -1;
+    return entryA->address - entryB->address;
+}
+
+static const char* getOpcodeName(unsigned char opcode) {
+    static const char* const names[] = { "LD", "NOT", "ADD", "AND", "ST", "JMP", "JMN", "JMZ" };
+    return names[opcode];
+}
+
+unsigned long long countProfiledInstructions(struct Profile* profile) {
+    unsigned long long instructionCount = 0;
+    unsigned long long runningRuns[2] = { 0, 0 };
+
+    for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
+        runningRuns[i % 2] += profile->runStarts[i] - profile->runEnds[i];
+        instructionCount += runningRuns[i % 2];
+    }
+
+    return instructionCount;
+}
+
+void writeProfileReport(struct Profile* profile, struct MachineState* state, struct Symbols* symbols, FILE* output) {
+    struct ProfileEntry* labels = calloc(ADDRESS_SPACE_SIZE, sizeof(struct ProfileEntry));
+    struct ProfileEntry* addresses = calloc(ADDRESS_SPACE_SIZE, sizeof(struct ProfileEntry));
+    unsigned long long totalCycles = 0;
+    unsigned long long totalExecutions = 0;
+    int labelCount = 0;
+    int addressCount = 0;
+    unsigned long long runningRuns[2] = { 0, 0 }; // runs of instructions at even and odd addresses
+
+    // Addresses before the first label are folded into an entry at address 0
+    for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
+        if (i == 0 || symbols->labelNames[i] != NULL) {
+            labels[labelCount++] = (struct ProfileEntry) { i, 0, 0 };
+        }
+
+        runningRuns[i % 2] += profile->runStarts[i] - profile->runEnds[i];
+        unsigned long long executions = runningRuns[i % 2];
+        unsigned long long cycles = executions * 4 - profile->jumps[i];
+
+        labels[labelCount - 1].executions += executions;
+        labels[labelCount - 1].cycles += cycles;
+        totalExecutions += executions;
+        totalCycles += cycles;
+
+        if (executions != 0) {
+            addresses[addressCount++] = (struct ProfileEntry) { i, executions, cycles };
+        }
+    }
+
+    qsort(labels, labelCount, sizeof(struct ProfileEntry), compareEntriesByCycles);
+    qsort(addresses, addressCount, sizeof(struct ProfileEntry), compareEntriesByCycles);
+
+    double cyclesPercent = totalCycles != 0 ? 100.0 / totalCycles : 0;
+
+    fprintf(output, "%llu instructions, %llu clock cycles.\n\n", totalExecutions, totalCycles);
+
+    fprintf(output, "Hottest labels:\n");
+    fprintf(output, "%14s  %7s  %14s  %-13s  %s\n", "Cycles", "%", "Instructions", "Addresses", "Label");
+
+    for (int i = 0; i < labelCount && i < REPORTED_LABELS && labels[i].cycles != 0; ++i) {
+        struct ProfileEntry* label = &labels[i];
+        int endAddress;
+        for (endAddress = label->address + 1; endAddress < ADDRESS_SPACE_SIZE && symbols->labelNames[endAddress] == NULL; ++endAddress);
+
+        fprintf(output, "%14llu  %7.3f  %14llu  0x%04X-0x%04X  %s\n", label->cycles, label->cycles * cyclesPercent, label->executions,
+            label->address, endAddress - 1, symbols->labelNames[label->address] != NULL ? symbols->labelNames[label->address] : "");
+    }
+
+    fprintf(output, "\nHottest addresses:\n");
+    fprintf(output, "%14s  %7s  %14s  %-7s  %-12s  %s\n", "Cycles", "%", "Instructions", "Address", "Instruction", "Location");
+
+    for (int i = 0; i < addressCount && i < REPORTED_ADDRESSES; ++i) {
+        struct ProfileEntry* address = &addresses[i];
+        unsigned short instruction = peekInstruction(state, address->address);
+
+        fprintf(output, "%14llu  %7.3f  %14llu  0x%04X   %-3s 0x%04X    ", address->cycles, address->cycles * cyclesPercent, address->executions,
+            address->address, getOpcodeName(instruction >> 13), instruction & 0x1fff);
+        printLocation(symbols, address->address, output);
+        fprintf(output, "\n");
+    }
+
+    free(labels);
+    free(addresses);
+}
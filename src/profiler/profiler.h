@@ -0,0 +1,21 @@
+#ifndef profiler
+#define profiler
+
+#include "../machine-state/machine-state.h"
+#include "../symbols/symbols.h"
+#include <stdio.h>
+
+// Filled by the threaded engine, which counts straight-line runs of instructions instead of every instruction. Each run
+// executes the instructions from its start up to its end, every 2 bytes. The PC only wraps around past the end of memory.
+struct Profile {
+    unsigned long long runStarts[ADDRESS_SPACE_SIZE + 2];
+    unsigned long long runEnds[ADDRESS_SPACE_SIZE + 2]; // address past the last instruction of the run
+    unsigned long long jumps[ADDRESS_SPACE_SIZE]; // executed jump instructions, which take 3 clock cycles instead of 4
+};
+
+// Writes the hottest labels, with the addresses from each label up to the next one, and the hottest addresses
+void writeProfileReport(struct Profile* profile, struct MachineState* state, struct Symbols* symbols, FILE* output);
+
+unsigned long long countProfiledInstructions(struct Profile* profile);
+
+#endif
@@ -1,4 +1,5 @@
 #include "program-input.h"
+#include "../clock-pacer/clock-pacer.h"
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
@@ -9,11 +10,48 @@ struct ProgramInput getProgramInput(int argc, const char * argv[]) {
     const char* binaryFilePath = NULL;
     const char* symbolsFilePath = NULL;
     int clockFrequencyKiloHz = 1;
+    enum EngineType engineType = EngineTypeSwitch;
+    enum OutputBufferPolicy outputBufferPolicy = OutputBufferPolicyLine;
+    enum InputBackpressure inputBackpressure = InputBackpressureBlock;
+    const char* inputFilePath = NULL;
+    unsigned long long maxCycles = 0;
+    unsigned long maxTimeMs = 0;
+    const char* fleetFilePath = NULL;
+    int fleetThreadCount = 0;
+    const char* profileFilePath = NULL;
+    const char* callGraphFilePath = NULL;
+    const char* traceFilePath = NULL;
+    const char* cycleTraceFilePath = NULL;
+    const char* replayFilePath = NULL;
+    const char* saveSnapshotFilePath = NULL;
+    const char* loadSnapshotFilePath = NULL;
 
     bool helpFlag = false;
     bool symbolsFlag = false;
     bool debugFlag = false;
     bool clockFlag = false;
+    bool engineFlag = false;
+    bool emitCFlag = false;
+    bool outputBufferFlag = false;
+    bool inputBackpressureFlag = false;
+    bool headlessFlag = false;
+    bool inputFlag = false;
+    bool maxCyclesFlag = false;
+    bool maxTimeFlag = false;
+    bool fleetFlag = false;
+    bool threadsFlag = false;
+    bool virtualTimeFlag = false;
+    bool detectNonTerminationFlag = false;
+    bool statsFlag = false;
+    bool perfCountersFlag = false;
+    bool profileFlag = false;
+    bool callGraphFlag = false;
+    bool traceFlag = false;
+    bool cycleTraceFlag = false;
+    bool lockstepFlag = false;
+    bool replayFlag = false;
+    bool saveSnapshotFlag = false;
+    bool loadSnapshotFlag = false;
 
     for (int i = 1; i < argc; ++i) {
         if (argv[i][0] == '-') {
@@ -50,13 +88,279 @@ struct ProgramInput getProgramInput(int argc, const char * argv[]) {
                     printf("Error: clock frequency was not provided.\n");
                     exit(1);
                 } else {
-                    clockFrequencyKiloHz = strtol(argv[++i], NULL, 0);
-                    if (errno != 0 || clockFrequencyKiloHz < 1 || clockFrequencyKiloHz > 1000) {
-                        printf("Error: \"%s\" is not a valid clock frequency.\n", argv[i]);
-                        exit(1);
+                    ++i;
+                    if (strcmp(argv[i], "unlimited") == 0) {
+                        clockFrequencyKiloHz = UNLIMITED_CLOCK_FREQUENCY;
+                    } else {
+                        clockFrequencyKiloHz = strtol(argv[i], NULL, 0);
+                        if (errno != 0 || clockFrequencyKiloHz < 1 || clockFrequencyKiloHz > 1000000) {
+                            printf("Error: \"%s\" is not a valid clock frequency.\n", argv[i]);
+                            exit(1);
+                        }
                     }
                     clockFlag = true;
                 }
+            } else if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--engine") == 0) {
+                if (engineFlag) {
+                    printf("Error: engine flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: engine name was not provided.\n");
+                    exit(1);
+                } else {
+                    ++i;
+                    if (strcmp(argv[i], "switch") == 0) {
+                        engineType = EngineTypeSwitch;
+                    } else if (strcmp(argv[i], "threaded") == 0) {
+                        engineType = EngineTypeThreaded;
+                    } else if (strcmp(argv[i], "jit") == 0) {
+                        engineType = EngineTypeJit;
+                    } else if (strcmp(argv[i], "cycle") == 0) {
+                        engineType = EngineTypeCycle;
+                    } else {
+                        printf("Error: \"%s\" is not a valid engine name.\n", argv[i]);
+                        exit(1);
+                    }
+                    engineFlag = true;
+                }
+            } else if (strcmp(argv[i], "--emit-c") == 0) {
+                if (emitCFlag) {
+                    printf("Error: emit C flag was used more than once.\n");
+                    exit(1);
+                } else {
+                    emitCFlag = true;
+                }
+            } else if (strcmp(argv[i], "--output-buffer") == 0) {
+                if (outputBufferFlag) {
+                    printf("Error: output buffer flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: output buffer policy was not provided.\n");
+                    exit(1);
+                } else {
+                    ++i;
+                    if (strcmp(argv[i], "none") == 0) {
+                        outputBufferPolicy = OutputBufferPolicyNone;
+                    } else if (strcmp(argv[i], "line") == 0) {
+                        outputBufferPolicy = OutputBufferPolicyLine;
+                    } else if (strcmp(argv[i], "full") == 0) {
+                        outputBufferPolicy = OutputBufferPolicyFull;
+                    } else {
+                        printf("Error: \"%s\" is not a valid output buffer policy.\n", argv[i]);
+                        exit(1);
+                    }
+                    outputBufferFlag = true;
+                }
+            } else if (strcmp(argv[i], "--input-backpressure") == 0) {
+                if (inputBackpressureFlag) {
+                    printf("Error: input backpressure flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: input backpressure policy was not provided.\n");
+                    exit(1);
+                } else {
+                    ++i;
+                    if (strcmp(argv[i], "block") == 0) {
+                        inputBackpressure = InputBackpressureBlock;
+                    } else if (strcmp(argv[i], "drop") == 0) {
+                        inputBackpressure = InputBackpressureDrop;
+                    } else {
+                        printf("Error: \"%s\" is not a valid input backpressure policy.\n", argv[i]);
+                        exit(1);
+                    }
+                    inputBackpressureFlag = true;
+                }
+            } else if (strcmp(argv[i], "--headless") == 0) {
+                if (headlessFlag) {
+                    printf("Error: headless flag was used more than once.\n");
+                    exit(1);
+                } else {
+                    headlessFlag = true;
+                }
+            } else if (strcmp(argv[i], "--input") == 0) {
+                if (inputFlag) {
+                    printf("Error: input flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: input file path was not provided.\n");
+                    exit(1);
+                } else {
+                    inputFilePath = argv[++i];
+                    inputFlag = true;
+                }
+            } else if (strcmp(argv[i], "--max-cycles") == 0) {
+                if (maxCyclesFlag) {
+                    printf("Error: max cycles flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: max cycles count was not provided.\n");
+                    exit(1);
+                } else {
+                    ++i;
+                    char* end;
+                    maxCycles = strtoull(argv[i], &end, 0);
+                    if (errno != 0 || *end != '\0' || argv[i][0] == '-' || maxCycles == 0) {
+                        printf("Error: \"%s\" is not a valid cycle count.\n", argv[i]);
+                        exit(1);
+                    }
+                    maxCyclesFlag = true;
+                }
+            } else if (strcmp(argv[i], "--max-time") == 0) {
+                if (maxTimeFlag) {
+                    printf("Error: max time flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: max time was not provided.\n");
+                    exit(1);
+                } else {
+                    ++i;
+                    char* end;
+                    maxTimeMs = strtoul(argv[i], &end, 0);
+                    if (errno != 0 || *end != '\0' || argv[i][0] == '-' || maxTimeMs == 0) {
+                        printf("Error: \"%s\" is not a valid time.\n", argv[i]);
+                        exit(1);
+                    }
+                    maxTimeFlag = true;
+                }
+            } else if (strcmp(argv[i], "--fleet") == 0) {
+                if (fleetFlag) {
+                    printf("Error: fleet flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: jobs file path was not provided.\n");
+                    exit(1);
+                } else {
+                    fleetFilePath = argv[++i];
+                    fleetFlag = true;
+                }
+            } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) {
+                if (threadsFlag) {
+                    printf("Error: threads flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: thread count was not provided.\n");
+                    exit(1);
+                } else {
+                    ++i;
+                    fleetThreadCount = strtol(argv[i], NULL, 0);
+                    if (errno != 0 || fleetThreadCount < 1 || fleetThreadCount > 1024) {
+                        printf("Error: \"%s\" is not a valid thread count.\n", argv[i]);
+                        exit(1);
+                    }
+                    threadsFlag = true;
+                }
+            } else if (strcmp(argv[i], "--virtual-time") == 0) {
+                if (virtualTimeFlag) {
+                    printf("Error: virtual time flag was used more than once.\n");
+                    exit(1);
+                } else {
+                    virtualTimeFlag = true;
+                }
+            } else if (strcmp(argv[i], "--detect-non-termination") == 0) {
+                if (detectNonTerminationFlag) {
+                    printf("Error: detect non-termination flag was used more than once.\n");
+                    exit(1);
+                } else {
+                    detectNonTerminationFlag = true;
+                }
+            } else if (strcmp(argv[i], "--stats") == 0) {
+                if (statsFlag) {
+                    printf("Error: stats flag was used more than once.\n");
+                    exit(1);
+                } else {
+                    statsFlag = true;
+                }
+            } else if (strcmp(argv[i], "--cycle-trace") == 0) {
+                if (cycleTraceFlag) {
+                    printf("Error: cycle trace flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: cycle trace file path was not provided.\n");
+                    exit(1);
+                } else {
+                    cycleTraceFilePath = argv[++i];
+                    cycleTraceFlag = true;
+                }
+            } else if (strcmp(argv[i], "--lockstep") == 0) {
+                if (lockstepFlag) {
+                    printf("Error: lockstep flag was used more than once.\n");
+                    exit(1);
+                } else {
+                    lockstepFlag = true;
+                }
+            } else if (strcmp(argv[i], "--perf-counters") == 0) {
+                if (perfCountersFlag) {
+                    printf("Error: perf counters flag was used more than once.\n");
+                    exit(1);
+                } else {
+                    perfCountersFlag = true;
+                }
+            } else if (strcmp(argv[i], "--profile") == 0) {
+                if (profileFlag) {
+                    printf("Error: profile flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: profile file path was not provided.\n");
+                    exit(1);
+                } else {
+                    profileFilePath = argv[++i];
+                    profileFlag = true;
+                }
+            } else if (strcmp(argv[i], "--call-graph") == 0) {
+                if (callGraphFlag) {
+                    printf("Error: call graph flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: call graph file path was not provided.\n");
+                    exit(1);
+                } else {
+                    callGraphFilePath = argv[++i];
+                    callGraphFlag = true;
+                }
+            } else if (strcmp(argv[i], "--trace") == 0) {
+                if (traceFlag) {
+                    printf("Error: trace flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: trace file path was not provided.\n");
+                    exit(1);
+                } else {
+                    traceFilePath = argv[++i];
+                    traceFlag = true;
+                }
+            } else if (strcmp(argv[i], "--replay") == 0) {
+                if (replayFlag) {
+                    printf("Error: replay flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: replay file path was not provided.\n");
+                    exit(1);
+                } else {
+                    replayFilePath = argv[++i];
+                    replayFlag = true;
+                }
+            } else if (strcmp(argv[i], "--save-snapshot") == 0) {
+                if (saveSnapshotFlag) {
+                    printf("Error: save snapshot flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: snapshot file path was not provided.\n");
+                    exit(1);
+                } else {
+                    saveSnapshotFilePath = argv[++i];
+                    saveSnapshotFlag = true;
+                }
+            } else if (strcmp(argv[i], "--load-snapshot") == 0) {
+                if (loadSnapshotFlag) {
+                    printf("Error: load snapshot flag was used more than once.\n");
+                    exit(1);
+                } else if (i == argc - 1) {
+                    printf("Error: snapshot file path was not provided.\n");
+                    exit(1);
+                } else {
+                    loadSnapshotFilePath = argv[++i];
+                    loadSnapshotFlag = true;
+                }
             } else {
                 printf("Error: unknown flag \"%s\".\n", argv[i]);
                 exit(1);
@@ -77,19 +381,88 @@ struct ProgramInput getProgramInput(int argc, const char * argv[]) {
         printf("w13sim [path/to/binary.bin]\n");
         printf("runs the simulator until ^C is pressed, or until a JMP instruction to the current address (unconditional infinite loop) is detected.\n\n");
         printf("Options:\n");
-        printf("-c [frequency] or --clock [frequency] - sets maximum clock frequency in kHz. Must be between 1 and 1000000. Default is 1000.\n");
+        printf("-c [frequency] or --clock [frequency] - sets maximum clock frequency in kHz. Must be between 1 and 1000000, or \"unlimited\". Default is 1.\n");
+        printf("--virtual-time - the clock register counts milliseconds of simulated clock cycles at the clock frequency instead of wall-clock time, and the simulation runs as fast as possible. The clock frequency can't be \"unlimited\".\n");
         printf("-h or --help - prints this message.\n");
+        printf("-e [name] or --engine [name] - selects the instruction execution engine: \"switch\", \"threaded\", \"jit\" (x86-64 only), or \"cycle\" (simulates every clock cycle of the microarchitecture with its control store). Without -d or --debug. Default is \"switch\".\n");
+        printf("--emit-c - instead of running the program, prints an equivalent C program to the standard output.\n");
         printf("-d or --debug - runs the simulator in paused state and enables the debugger.\n");
-        printf("-s [path/to/symbols.csv] or --symbols [path/to/symbols.csv] - supplies the debugger with symbols info. Without -d or --debug it is ignored.\n\n");
+        printf("--headless - runs without configuring the terminal, reading input from a file or pipe. The exit status is 0 if an unconditional infinite loop was detected, 2 if the program tried to read past the end of input, 3 if the cycle limit, 4 if the time limit was reached, and 5 if non-termination was detected. Implies \"-c unlimited\" and \"--output-buffer full\" unless these are given.\n");
+        printf("--input [path/to/input] - with --headless, reads input from the file instead of the standard input.\n");
+        printf("--max-cycles [count] - ends the simulation after the number of clock cycles. Without -d or --debug.\n");
+        printf("--max-time [milliseconds] - ends the simulation after the wall-clock time. Without -d or --debug.\n");
+        printf("--detect-non-termination - ends the simulation when the program provably runs forever without reading or writing the terminal I/O or clock register, with exit status 5. Without -d or --debug.\n");
+        printf("--stats - when the simulation ends, prints the number of executed clock cycles, the wall-clock time of the simulation, and the clock cycles per second to the standard error. Without -d or --debug.\n");
+        printf("--perf-counters - counts host cycles, instructions, branch misses, L1 data cache read misses, and cycles in the kernel while simulating with hardware performance counters (Linux only), and when the simulation ends prints them per simulated instruction and clock cycle to the standard error. Without -d or --debug.\n");
+        printf("--profile [path/to/profile.txt] - counts instructions executed at every address and writes the hottest labels and addresses to the file at exit. Uses the threaded engine and the symbols file if supplied. Without -d or --debug.\n");
+        printf("--call-graph [path/to/stacks.folded] - infers subroutine calls from stores into arguments of returning JMP instructions, and writes the cycles spent in every call stack to the file at exit, in the folded format of flame graph tools. With --profile, the profile also lists subroutines with inclusive and exclusive cycles. Uses the switch engine and the symbols file if supplied. Without -d or --debug.\n");
+        printf("--trace [path/to/trace.w13t] - records every executed instruction, and values read from the terminal I/O and clock registers, to the file. Uses an instrumented switch engine and doesn't skip idle polling loops. ^C ends the simulation with exit status 130. Without -d or --debug.\n");
+        printf("--cycle-trace [path/to/cycles.txt] - writes the state, registers, buses, and active control signals after every clock cycle to the file. Uses the cycle engine. Without -d or --debug.\n");
+        printf("--lockstep - executes every instruction with both the cycle engine and the switch engine, and exits with status 1 at the first instruction whose results differ. Instructions reading the terminal I/O or clock register aren't compared. Uses the cycle engine. Without -d or --debug.\n");
+        printf("--replay [path/to/trace.w13t] - instead of running a binary file, runs the program recorded in the trace as fast as possible, reading the recorded values from the terminal I/O and clock registers, and checking every instruction against the trace. The exit status is the recorded one, or 1 if the execution diverges from the trace. The divergence is located using the symbols file if supplied.\n");
+        printf("--save-snapshot [path/to/snapshot.w13s] - when the simulation ends, saves the registers, memory, clock register, unread input, and symbols (if supplied) to the file. Without -d or --debug, which has the \"save\" command instead.\n");
+        printf("--load-snapshot [path/to/snapshot.w13s] - instead of loading a binary file, resumes the machine saved in the snapshot. The clock register continues counting from the saved value. In the debugger, also restores breakpoints, and symbols unless a symbols file is supplied.\n");
+        printf("--fleet [path/to/jobs.txt] - instead of running one program, runs many in headless mode and prints a summary. Each line of the jobs file lists a binary file path, an input file path (or \"-\" for no input), and an output file path.\n");
+        printf("-j [count] or --threads [count] - with --fleet, sets the number of threads running jobs. Default is the number of CPUs.\n");
+        printf("--input-backpressure [policy] - sets what happens to typed characters when 256 of them are waiting to be read by the program: \"block\" (they wait) or \"drop\" (they are discarded). Default is \"block\".\n");
+        printf("--output-buffer [policy] - sets when the program's terminal output is written: \"none\" (after every character), \"line\" (after every newline), or \"full\" (when 64 KiB are buffered). Output is also written when the program reads input or the clock, when the debugger pauses, and after 1 ms of inactivity. Default is \"line\".\n");
+        printf("-s [path/to/symbols.csv] or --symbols [path/to/symbols.csv] - supplies the debugger, the profilers, trace replays, and saved snapshots with symbols info. Without -d, --debug, --profile, --call-graph, --replay, or --save-snapshot it is ignored.\n\n");
         printf("The symbols file must be in CSV format with three columns:\n");
         printf("- the memory address,\n");
         printf("- data type (one of following: \"char\", \"int\", or \"instruction\"),\n");
         printf("- label name (unique; 0-31 characters: digits, upper- or lowercase letters, and underscores; the first character can't be a digit).\n");
         exit(0);
-    } else if (binaryFilePath == NULL) {
+    } else if (fleetFlag && (binaryFilePath != NULL || debugFlag || headlessFlag || emitCFlag)) {
+        printf("Error: fleet mode can't be used with a binary file path, the debugger, headless mode, or C emission.\n");
+        exit(1);
+    } else if (virtualTimeFlag && clockFrequencyKiloHz == UNLIMITED_CLOCK_FREQUENCY) {
+        printf("Error: virtual time requires a limited clock frequency.\n");
+        exit(1);
+    } else if (threadsFlag && !fleetFlag) {
+        printf("Error: thread count can only be used in fleet mode.\n");
+        exit(1);
+    } else if (replayFlag && (binaryFilePath != NULL || debugFlag || headlessFlag || emitCFlag || fleetFlag || engineFlag || profileFlag || callGraphFlag || traceFlag || inputFlag || maxCyclesFlag || maxTimeFlag || clockFlag || virtualTimeFlag || detectNonTerminationFlag || inputBackpressureFlag)) {
+        printf("Error: replay can only be used with output buffer options.\n");
+        exit(1);
+    } else if (traceFlag && (debugFlag || fleetFlag || emitCFlag || engineFlag || profileFlag || callGraphFlag)) {
+        printf("Error: tracing can't be used with the debugger, fleet mode, C emission, engine selection, or profiling.\n");
+        exit(1);
+    } else if ((saveSnapshotFlag || loadSnapshotFlag) && (fleetFlag || replayFlag || emitCFlag)) {
+        printf("Error: snapshots can't be used with fleet mode, replay, or C emission.\n");
+        exit(1);
+    } else if (saveSnapshotFlag && debugFlag) {
+        printf("Error: in the debugger, snapshots are saved with the \"save\" command.\n");
+        exit(1);
+    } else if (loadSnapshotFlag && binaryFilePath != NULL) {
+        printf("Error: a snapshot can't be loaded together with a binary file.\n");
+        exit(1);
+    } else if (binaryFilePath == NULL && !fleetFlag && !replayFlag && !loadSnapshotFlag) {
         printf("Error: binary file path was not provided.\n");
         exit(1);
+    } else if (headlessFlag && debugFlag) {
+        printf("Error: headless mode can't be used with the debugger.\n");
+        exit(1);
+    } else if ((profileFlag || callGraphFlag) && (debugFlag || fleetFlag || emitCFlag || engineFlag)) {
+        printf("Error: profiling can't be used with the debugger, fleet mode, C emission, or engine selection.\n");
+        exit(1);
+    } else if ((statsFlag || perfCountersFlag) && (debugFlag || fleetFlag || replayFlag || emitCFlag)) {
+        printf("Error: statistics and performance counters can't be used with the debugger, fleet mode, replay, or C emission.\n");
+        exit(1);
+    } else if ((cycleTraceFlag || lockstepFlag) && (debugFlag || fleetFlag || emitCFlag || replayFlag || profileFlag || callGraphFlag || traceFlag || (engineFlag && engineType != EngineTypeCycle))) {
+        printf("Error: cycle tracing and lockstep mode can only be used with the cycle engine, without the debugger, fleet mode, C emission, replay, profiling, or tracing.\n");
+        exit(1);
+    } else if (inputFlag && !headlessFlag) {
+        printf("Error: input file can only be used in headless mode.\n");
+        exit(1);
     }
 
-    return (struct ProgramInput) { debugFlag, binaryFilePath, symbolsFilePath, clockFrequencyKiloHz };
+    if (headlessFlag || fleetFlag || replayFlag) {
+        if (!clockFlag && !virtualTimeFlag) clockFrequencyKiloHz = UNLIMITED_CLOCK_FREQUENCY;
+        if (!outputBufferFlag) outputBufferPolicy = OutputBufferPolicyFull;
+    }
+
+    if (profileFlag) engineType = EngineTypeProfiling;
+    if (cycleTraceFlag || lockstepFlag) engineType = EngineTypeCycle;
+
+    return (struct ProgramInput) { debugFlag, binaryFilePath, symbolsFilePath, clockFrequencyKiloHz, virtualTimeFlag, engineType, emitCFlag, outputBufferPolicy, inputBackpressure, headlessFlag, inputFilePath, maxCycles, maxTimeMs, fleetFilePath, fleetThreadCount, detectNonTerminationFlag, profileFilePath, callGraphFilePath, traceFilePath, replayFilePath, saveSnapshotFilePath, loadSnapshotFilePath, statsFlag, perfCountersFlag, cycleTraceFilePath, lockstepFlag };
 }
\ No newline at end of file
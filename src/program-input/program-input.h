@@ -2,12 +2,37 @@
 #define program_input
 
 #include <stdbool.h>
+#include "../engine/engine.h"
+#include "../terminal-output/terminal-output.h"
+#include "../keyboard-input/keyboard-input.h"
 
 struct ProgramInput {
     bool debugMode;
     const char* binaryFilePath;
     const char* symbolsFilePath;
     int clockFrequencyKiloHz;
+    bool virtualTimeMode;
+    enum EngineType engineType;
+    bool emitCMode;
+    enum OutputBufferPolicy outputBufferPolicy;
+    enum InputBackpressure inputBackpressure;
+    bool headlessMode;
+    const char* inputFilePath;
+    unsigned long long maxCycles; // 0 if unlimited
+    unsigned long maxTimeMs; // 0 if unlimited
+    const char* fleetFilePath;
+    int fleetThreadCount; // 0 if it should match the number of CPUs
+    bool nonTerminationDetectionMode;
+    const char* profileFilePath;
+    const char* callGraphFilePath;
+    const char* traceFilePath;
+    const char* replayFilePath;
+    const char* saveSnapshotFilePath;
+    const char* loadSnapshotFilePath;
+    bool statsMode;
+    bool perfCountersMode;
+    const char* cycleTraceFilePath;
+    bool lockstepMode;
 };
 
 struct ProgramInput getProgramInput(int argc, const char * argv[]);
@@ -0,0 +1,153 @@
+#include "snapshot.h"
+#include "../machine-state/machine-state.h"
+#include "../keyboard-input/keyboard-input.h"
+#include "../symbols/symbols.h"
+#include "../time/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h> // POSIX
+#include <unistd.h> // POSIX
+#include <sys/mman.h> // POSIX
+#include <sys/stat.h> // POSIX
+
+bool saveSnapshot(const char* path, struct MachineState* state, bool* breakpoints, struct Symbols* symbols) {
+    unsigned int labelCount = 0;
+    bool hasSymbols = false;
+
+    if (symbols != NULL) {
+        for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
+            if (symbols->labelNames[i] != NULL) ++labelCount;
+            if (symbols->labelNames[i] != NULL || symbols->dataTypes[i] != DataTypeNone) hasSymbols = true;
+        }
+    }
+
+    size_t size = sizeof(struct Snapshot) + labelCount * sizeof(struct SnapshotLabel);
+    struct Snapshot* image = calloc(1, size);
+
+    memcpy(image->magic, SNAPSHOT_MAGIC, sizeof(image->magic));
+    image->version = SNAPSHOT_VERSION;
+    image->byteOrder = SNAPSHOT_BYTE_ORDER;
+    image->headerSize = sizeof(struct Snapshot);
+    image->labelCount = labelCount;
+    image->cycleCount = state->cycleCount;
+    image->clockRegisterMs = state->simulationMeasuredTimeMs - state->simulationStartTimeMs - state->simulationIdleTimeMs;
+    image->PC = state->PC;
+    image->A = state->A;
+    image->hasBreakpoints = breakpoints != NULL;
+    image->hasSymbols = hasSymbols;
+    image->pendingInputLength = getPendingInput(state->keyboardInput, image->pendingInput);
+    memcpy(image->memory, state->memory, ADDRESS_SPACE_SIZE);
+
+    if (breakpoints != NULL) memcpy(image->breakpoints, breakpoints, ADDRESS_SPACE_SIZE);
+
+    if (hasSymbols) {
+        int label = 0;
+
+        for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
+            image->dataTypes[i] = symbols->dataTypes[i];
+
+            if (symbols->labelNames[i] != NULL) {
+                image->labels[label].address = i;
+                strncpy(image->labels[label].name, symbols->labelNames[i], LABEL_NAME_MAX_LENGTH);
+                ++label;
+            }
+        }
+    }
+
+    FILE* file = fopen(path, "wb");
+    bool success = file != NULL && fwrite(image, 1, size, file) == size;
+    if (file != NULL && fclose(file) != 0) success = false;
+    free(image);
+
+    if (!success) printf("Error: could not write file \"%s\".\n", path);
+
+    return success;
+}
+
+// Reading a bool stored as another value than 0 or 1 is undefined, so the bytes are checked
+static bool areBoolsValid(const bool* values, size_t count) {
+    const unsigned char* bytes = (const unsigned char*) values;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (bytes[i] > 1) return false;
+    }
+
+    return true;
+}
+
+static bool isSnapshotValid(struct Snapshot* image, size_t size) {
+    bool isHeaderValid = size >= sizeof(struct Snapshot)
+        && memcmp(image->magic, SNAPSHOT_MAGIC, sizeof(image->magic)) == 0
+        && image->version == SNAPSHOT_VERSION
+        && image->byteOrder == SNAPSHOT_BYTE_ORDER
+        && image->headerSize == sizeof(struct Snapshot)
+        && size == sizeof(struct Snapshot) + image->labelCount * sizeof(struct SnapshotLabel)
+        && image->pendingInputLength <= INPUT_FILE_BUFFER_SIZE
+        && areBoolsValid(&image->hasBreakpoints, 1)
+        && areBoolsValid(&image->hasSymbols, 1)
+        && areBoolsValid(image->breakpoints, ADDRESS_SPACE_SIZE);
+
+    if (!isHeaderValid) return false;
+
+    // Label names are hashed and compared before they are truncated
+    for (unsigned int i = 0; i < image->labelCount; ++i) {
+        if (memchr(image->labels[i].name, 0, LABEL_NAME_MAX_LENGTH + 1) == NULL) return false;
+    }
+
+    return true;
+}
+
+bool loadSnapshot(const char* path, struct MachineState* state, bool* breakpoints, struct Symbols* symbols) {
+    int fileDescriptor = open(path, O_RDONLY);
+    struct stat fileStatus;
+
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0) {
+        printf("Error: could not read file \"%s\".\n", path);
+        if (fileDescriptor >= 0) close(fileDescriptor);
+        return false;
+    }
+
+    size_t size = fileStatus.st_size;
+    struct Snapshot* image = size >= sizeof(struct Snapshot) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) : MAP_FAILED;
+    close(fileDescriptor);
+
+    if (image == MAP_FAILED || !isSnapshotValid(image, size)) {
+        printf("Error: \"%s\" is not a snapshot file of this version of the simulator.\n", path);
+        if (image != MAP_FAILED) munmap(image, size);
+        return false;
+    }
+
+    unsigned long now = getTimeMs();
+
+    state->haltReason = HaltReasonNone;
+    state->PC = image->PC % ADDRESS_SPACE_SIZE;
+    state->A = image->A;
+    state->cycleCount = image->cycleCount;
+    state->simulationStartTimeMs = now - image->clockRegisterMs;
+    state->simulationMeasuredTimeMs = now;
+    state->simulationIdleTimeMs = 0;
+    memcpy(state->memory, image->memory, ADDRESS_SPACE_SIZE);
+    invalidateDecodedInstructions(state);
+    setPendingInput(state->keyboardInput, image->pendingInput, image->pendingInputLength);
+
+    if (breakpoints != NULL && image->hasBreakpoints) memcpy(breakpoints, image->breakpoints, ADDRESS_SPACE_SIZE);
+
+    if (symbols != NULL && image->hasSymbols) {
+        freeSymbols(symbols);
+
+        for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
+            symbols->dataTypes[i] = image->dataTypes[i] <= DataTypeInt ? image->dataTypes[i] : DataTypeNone;
+        }
+
+        for (unsigned int i = 0; i < image->labelCount; ++i) {
+            struct SnapshotLabel* label = &image->labels[i];
+            if (label->address < ADDRESS_SPACE_SIZE) addLabel(symbols, label->address, label->name);
+        }
+    }
+
+    munmap(image, size);
+
+    return true;
+}
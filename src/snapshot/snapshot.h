@@ -0,0 +1,48 @@
+#ifndef snapshot_h
+#define snapshot_h
+
+#include "../machine-state/machine-state.h"
+#include "../keyboard-input/keyboard-input.h"
+#include "../symbols/symbols.h"
+#include <stdbool.h>
+
+#define SNAPSHOT_MAGIC "W13SNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304 // written in the byte order of the host
+
+struct SnapshotLabel {
+    unsigned short address;
+    char name[LABEL_NAME_MAX_LENGTH + 1];
+};
+
+// Layout of a snapshot file, which is memory mapped when loaded. It's only portable between hosts with the same byte order
+// and sizes of types, which the header identifies.
+struct Snapshot {
+    char magic[8];
+    unsigned int version;
+    unsigned int byteOrder;
+    unsigned int headerSize; // sizeof(struct Snapshot)
+    unsigned int labelCount;
+    unsigned long long cycleCount;
+    unsigned long long clockRegisterMs; // value of the clock register, which continues counting from it when loaded
+    unsigned short PC;
+    unsigned char A;
+    bool hasBreakpoints; // breakpoints of the debugger are saved
+    bool hasSymbols;
+    unsigned int pendingInputLength;
+    char pendingInput[INPUT_FILE_BUFFER_SIZE]; // characters the program hasn't read yet
+    unsigned char memory[ADDRESS_SPACE_SIZE];
+    bool breakpoints[ADDRESS_SPACE_SIZE];
+    unsigned char dataTypes[ADDRESS_SPACE_SIZE];
+    struct SnapshotLabel labels[]; // labelCount labels sorted by address
+};
+
+// Writes the machine state with its pending input, and the breakpoints and symbols unless they're NULL or empty, to the file.
+// Prints an error and returns false if the file can't be written.
+bool saveSnapshot(const char* path, struct MachineState* state, bool* breakpoints, struct Symbols* symbols);
+
+// Restores the machine state with its pending input from the file, and replaces the breakpoints and symbols with saved
+// ones unless they're NULL or weren't saved. The keyboard input must be attached but not started. Prints an error and returns false if the file isn't a valid snapshot.
+bool loadSnapshot(const char* path, struct MachineState* state, bool* breakpoints, struct Symbols* symbols);
+
+#endif
@@ -0,0 +1,193 @@
+#include "symbols.h"
+#include "../machine-state/machine-state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h> // POSIX
+#include <errno.h>
+
+void parseSymbolsFile(struct Symbols* symbols, const char* path) {
+    if (path == NULL) return;
+
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) {
+        printf("Error: could not read file \"%s\".\n", path);
+        exit(1);
+    }
+
+    char line[128] = {0};
+    char* addressString;
+    char* dataTypeString;
+    char* labelName;
+    int lineNumber = 0;
+    bool addressDescribed[ADDRESS_SPACE_SIZE] = { false };
+
+    while (fgets(line, 127, file) != NULL) {
+        ++lineNumber;
+
+        addressString = strtok(line, " ,\t\n");
+        dataTypeString = strtok(NULL, " ,\t\n");
+        labelName = strtok(NULL, " ,\t\n");
+
+        if (addressString == NULL) continue;
+        
+        if (dataTypeString == NULL) {
+            printf("Error: in file \"%s\" line %d has too few columns.\n", path, lineNumber);
+            exit(1);
+        }
+
+        int addressNumber = strtol(addressString, NULL, 0);
+        if (errno != 0) {
+            printf("Error: in file \"%s\" line %d: %s could not be parsed as a number.\n", path, lineNumber, addressString);
+            exit(1);
+        } else if (addressNumber < 0 || addressNumber >= ADDRESS_SPACE_SIZE) {
+            printf("Error: in file \"%s\" line %d: address %s is out of range.\n", path, lineNumber, addressString);
+            exit(1);
+        } else if (addressDescribed[addressNumber]) {
+            printf("Error: in file \"%s\" line %d: address 0x%04X was described multiple times.\n", path, lineNumber, addressNumber);
+            exit(1);
+        }
+        addressDescribed[addressNumber] = true;
+
+        enum DataType dataType;
+        if (strcasecmp(dataTypeString, "int") == 0) {
+            dataType = DataTypeInt;
+        } else if (strcasecmp(dataTypeString, "char") == 0) {
+            dataType = DataTypeChar;
+        } else if (strcasecmp(dataTypeString, "instruction") == 0) {
+            dataType = DataTypeInstruction;
+        } else {
+            printf("Error: in file \"%s\" line %d: unknown data type \"%s\".\n", path, lineNumber, dataTypeString);
+            exit(1);
+        }
+
+        symbols->dataTypes[addressNumber] = dataType;
+
+        if (labelName != NULL) {
+            if (strlen(labelName) > LABEL_NAME_MAX_LENGTH) {
+                printf("Error: in file \"%s\" line %d: label name must not be longer than %d characters.\n", path, lineNumber, LABEL_NAME_MAX_LENGTH);
+                exit(1);
+            }
+
+            if (!addLabel(symbols, addressNumber, labelName)) {
+                printf("Error: in file \"%s\" line %d: label name \"%s\" is not unique.\n", path, lineNumber, labelName);
+                exit(1);
+            }
+        }
+    }
+
+    fclose(file);
+
+    for (int i = 0; i < ADDRESS_SPACE_SIZE - 1; ++i) {
+        if (symbols->dataTypes[i] == DataTypeInstruction) {
+            symbols->dataTypes[i+1] = DataTypeNone;
+        }
+    }
+}
+
+// FNV-1a
+static unsigned int hashLabelName(const char* name) {
+    unsigned int hash = 2166136261u;
+    for (; *name != 0; ++name) hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash;
+}
+
+// Returns the slot of the label in the index, or the empty slot where it would be inserted
+static int findLabelSlot(struct Symbols* symbols, const char* name) {
+    int slot = hashLabelName(name) % LABEL_INDEX_SIZE;
+
+    while (symbols->labelIndex[slot] != 0 && strcmp(symbols->labelNames[symbols->labelIndex[slot] - 1], name) != 0) {
+        slot = (slot + 1) % LABEL_INDEX_SIZE;
+    }
+
+    return slot;
+}
+
+// Replaced labels can't be removed from the open addressing index, so it's rebuilt without them
+static void rebuildLabelIndex(struct Symbols* symbols) {
+    memset(symbols->labelIndex, 0, sizeof(symbols->labelIndex));
+
+    for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
+        if (symbols->labelNames[i] != NULL) symbols->labelIndex[findLabelSlot(symbols, symbols->labelNames[i])] = i + 1;
+    }
+}
+
+// Copies the names of current labels to a new arena, dropping replaced ones
+static void compactNameArena(struct Symbols* symbols) {
+    char* arena = malloc(NAME_ARENA_SIZE);
+    int arenaLength = 0;
+
+    for (int i = 0; i < ADDRESS_SPACE_SIZE; ++i) {
+        if (symbols->labelNames[i] == NULL) continue;
+        int nameLength = strlen(symbols->labelNames[i]);
+        memcpy(arena + arenaLength, symbols->labelNames[i], nameLength + 1);
+        symbols->labelNames[i] = arena + arenaLength;
+        arenaLength += nameLength + 1;
+    }
+
+    free(symbols->nameArena);
+    symbols->nameArena = arena;
+    symbols->nameArenaLength = arenaLength;
+}
+
+bool addLabel(struct Symbols* symbols, unsigned short address, const char* name) {
+    int slot = findLabelSlot(symbols, name);
+
+    if (symbols->labelIndex[slot] != 0) return symbols->labelIndex[slot] - 1 == address;
+
+    int nameLength = 0;
+    while (nameLength < LABEL_NAME_MAX_LENGTH && name[nameLength] != 0) ++nameLength;
+
+    bool isReplacing = symbols->labelNames[address] != NULL;
+    if (isReplacing) symbols->labelNames[address] = NULL;
+
+    if (symbols->nameArena == NULL || symbols->nameArenaLength + nameLength + 1 > NAME_ARENA_SIZE) {
+        compactNameArena(symbols);
+    }
+
+    char* storedName = symbols->nameArena + symbols->nameArenaLength;
+    memcpy(storedName, name, nameLength);
+    storedName[nameLength] = 0;
+    symbols->nameArenaLength += nameLength + 1;
+    symbols->labelNames[address] = storedName;
+
+    if (isReplacing) {
+        rebuildLabelIndex(symbols);
+    } else {
+        symbols->labelIndex[slot] = address + 1;
+    }
+
+    return true;
+}
+
+int findLabel(struct Symbols* symbols, const char* name) {
+    return symbols->labelIndex[findLabelSlot(symbols, name)] - 1;
+}
+
+int findLabelAtOrBefore(struct Symbols* symbols, unsigned short address) {
+    int labelAddress = address % ADDRESS_SPACE_SIZE;
+    while (labelAddress >= 0 && symbols->labelNames[labelAddress] == NULL) --labelAddress;
+    return labelAddress;
+}
+
+void printLocation(struct Symbols* symbols, unsigned short address, FILE* output) {
+    int labelAddress = findLabelAtOrBefore(symbols, address);
+
+    if (labelAddress < 0) {
+        fprintf(output, "0x%04X", address);
+    } else if (labelAddress == address) {
+        fprintf(output, "%s", symbols->labelNames[labelAddress]);
+    } else {
+        fprintf(output, "%s+%d", symbols->labelNames[labelAddress], address - labelAddress);
+    }
+}
+
+void freeSymbols(struct Symbols* symbols) {
+    memset(symbols->labelNames, 0, sizeof(symbols->labelNames));
+    memset(symbols->labelIndex, 0, sizeof(symbols->labelIndex));
+    free(symbols->nameArena);
+    symbols->nameArena = NULL;
+    symbols->nameArenaLength = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef symbols_h
+#define symbols_h
+
+#include "../machine-state/machine-state.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+#define LABEL_NAME_MAX_LENGTH 31
+
+enum DataType {
+    DataTypeNone = 0,
+    DataTypeInstruction,
+    DataTypeChar,
+    DataTypeInt
+};
+
+#define LABEL_INDEX_SIZE 0x4000 // twice the maximum number of labels, a power of 2
+#define NAME_ARENA_SIZE (ADDRESS_SPACE_SIZE * (LABEL_NAME_MAX_LENGTH + 1)) // fits the longest names at all addresses
+
+struct Symbols {
+    char* labelNames[ADDRESS_SPACE_SIZE]; // NULL if the address has no label, names are stored in the arena
+    enum DataType dataTypes[ADDRESS_SPACE_SIZE];
+    unsigned short labelIndex[LABEL_INDEX_SIZE]; // hash table of label addresses plus 1 by their names, 0 in empty slots
+    char* nameArena; // names of labels one after another, names of replaced labels are only dropped when it's full
+    int nameArenaLength;
+};
+
+// Reads the symbols file produced by the assembler into zero-initialized or previously filled symbols, unless the path is
+// NULL. Prints an error and exits if the file is invalid.
+void parseSymbolsFile(struct Symbols* symbols, const char* path);
+
+// Labels the address, replacing its previous label. Returns false if another address has the label.
+bool addLabel(struct Symbols* symbols, unsigned short address, const char* name);
+
+// Returns the address of the label, or -1 if there's no such label
+int findLabel(struct Symbols* symbols, const char* name);
+
+// Returns the address of the closest label at or before the address, or -1 if there's none
+int findLabelAtOrBefore(struct Symbols* symbols, unsigned short address);
+
+// Writes the address as the closest preceding label and an offset, e.g. "loop+2", or as a number if there's no such label
+void printLocation(struct Symbols* symbols, unsigned short address, FILE* output);
+
+// Removes all labels, data types are kept
+void freeSymbols(struct Symbols* symbols);
+
+#endif
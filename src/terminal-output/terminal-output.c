@@ -0,0 +1,40 @@
+#include "terminal-output.h"
+#include "../time/time.h"
+#include <stdio.h>
+
+#define OUTPUT_IDLE_TIMEOUT_NS 1000000
+
+struct TerminalOutput getTerminalOutput(enum OutputBufferPolicy policy, FILE* stream) {
+    return (struct TerminalOutput) { policy, stream, 0, 0 };
+}
+
+void putOutputChar(struct TerminalOutput* output, char ch) {
+    if (output->bufferLength == 0) output->oldestCharTimeNs = getTimeNs();
+
+    output->buffer[output->bufferLength++] = ch;
+
+    if (output->policy == OutputBufferPolicyNone
+        || (output->policy == OutputBufferPolicyLine && ch == '\n')
+        || output->bufferLength == OUTPUT_BUFFER_SIZE) {
+        flushOutput(output);
+    }
+}
+
+void flushOutput(struct TerminalOutput* output) {
+    if (output->bufferLength == 0) return;
+
+    if (output->write != NULL) {
+        output->write(output->writeContext, output->buffer, output->bufferLength);
+    } else if (output->stream != NULL) {
+        fwrite(output->buffer, sizeof(char), output->bufferLength, output->stream);
+        fflush(output->stream);
+    }
+
+    output->bufferLength = 0;
+}
+
+void flushIdleOutput(struct TerminalOutput* output) {
+    if (output->bufferLength > 0 && getTimeNs() - output->oldestCharTimeNs >= OUTPUT_IDLE_TIMEOUT_NS) {
+        flushOutput(output);
+    }
+}
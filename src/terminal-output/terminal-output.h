@@ -0,0 +1,38 @@
+#ifndef terminal_output
+#define terminal_output
+
+#include <stdio.h>
+
+#define OUTPUT_BUFFER_SIZE 0x10000
+
+enum OutputBufferPolicy {
+    OutputBufferPolicyNone, // every character is written immediately
+    OutputBufferPolicyLine, // the buffer is also flushed after a newline
+    OutputBufferPolicyFull // the buffer is flushed only when it fills up, or on events listed below
+};
+
+struct TerminalOutput {
+    enum OutputBufferPolicy policy;
+    FILE* stream;
+    int bufferLength;
+    unsigned long long oldestCharTimeNs;
+    char buffer[OUTPUT_BUFFER_SIZE];
+    void (*write)(void* context, const char* characters, int length); // used instead of the stream if not NULL
+    void* writeContext;
+};
+
+// Output to a NULL stream is discarded
+struct TerminalOutput getTerminalOutput(enum OutputBufferPolicy policy, FILE* stream);
+
+// Buffers a character written by the simulated program to the terminal
+void putOutputChar(struct TerminalOutput* output, char ch);
+
+// Writes all buffered characters to the stream. Must be called when the program reads input or the clock, when the
+// simulation pauses, and at exit
+void flushOutput(struct TerminalOutput* output);
+
+// Flushes the buffer if its oldest character has been waiting for longer than the idle timeout. Called at the end of
+// every batch of simulated cycles
+void flushIdleOutput(struct TerminalOutput* output);
+
+#endif
@@ -0,0 +1,131 @@
+#include "threaded-engine.h"
+#include "../machine-state/machine-state.h"
+#include "../terminal-output/terminal-output.h"
+#include "../profiler/profiler.h"
+
+// Fetching an instruction that isn't decoded may read memory-mapped registers, so the cycle count is brought up to date.
+// Instructions at the end of memory are never decoded, so the profile learns about the PC wrapping around here. If the fetch
+// halts the machine, the instruction still executes, as in step(), and the run ends after it.
+#define DISPATCH() \
+    do { \
+        instruction = state->decodedInstructions[PC]; \
+        if (instruction.clockCycles == 0) { \
+            state->cycleCount = initialCycleCount + cycles; \
+            instruction = decodeInstructionAt(state, PC); \
+            if (state->haltReason != HaltReasonNone) cycleBudget = 0; \
+            if (profile != NULL && PC >= ADDRESS_SPACE_SIZE - 2 && instruction.opcode < 5) PROFILE_RUN_END(PC + 2, 0); \
+        } \
+        cycles += instruction.clockCycles; \
+        goto *handlers[instruction.opcode]; \
+    } while (0)
+
+#define NEXT() \
+    do { \
+        if (cycles >= cycleBudget) goto end; \
+        DISPATCH(); \
+    } while (0)
+
+// Memory-mapped registers may depend on the cycle count, which is otherwise only updated at the end
+#define READ_MEMORY(address) \
+    ((address) < TIME_INTERFACE_ADDRESS \
+        ? state->memory[address] \
+        : (state->cycleCount = initialCycleCount + cycles - instruction.clockCycles, getMemoryMappedRegister(state, address)))
+
+// Reading a memory-mapped register may halt the machine
+#define NEXT_AFTER_READ() \
+    do { \
+        if (instruction.argument >= TIME_INTERFACE_ADDRESS && state->haltReason != HaltReasonNone) goto end; \
+        NEXT(); \
+    } while (0)
+
+// Straight-line runs of instructions end at jumps, so profiling only costs anything there
+#define PROFILE_RUN_END(endAddress, nextAddress) \
+    do { \
+        ++profile->runEnds[endAddress]; \
+        ++profile->runStarts[nextAddress]; \
+    } while (0)
+
+#define PROFILE_JUMP(isTaken) \
+    do { \
+        if (profile != NULL) { \
+            ++profile->jumps[PC]; \
+            if (isTaken) PROFILE_RUN_END(PC + 2, instruction.argument); \
+        } \
+    } while (0)
+
+unsigned long runThreaded(struct MachineState* state, void* context, unsigned long cycleBudget) {
+    static void* const handlers[] = {
+        &&executeLD,
+        &&executeNOT,
+        &&executeADD,
+        &&executeAND,
+        &&executeST,
+        &&executeJMP,
+        &&executeJMN,
+        &&executeJMZ
+    };
+
+    struct Profile* profile = context; // NULL if not profiling
+    unsigned short PC = state->PC;
+    unsigned char A = state->A;
+    unsigned long cycles = 0;
+    unsigned long long initialCycleCount = state->cycleCount;
+    struct DecodedInstruction instruction;
+
+    if (profile != NULL) ++profile->runStarts[PC];
+
+    DISPATCH();
+
+executeLD:
+    A = READ_MEMORY(instruction.argument);
+    PC = (PC + 2) % ADDRESS_SPACE_SIZE;
+    NEXT_AFTER_READ();
+
+executeNOT:
+    A = ~READ_MEMORY(instruction.argument);
+    PC = (PC + 2) % ADDRESS_SPACE_SIZE;
+    NEXT_AFTER_READ();
+
+executeADD:
+    A += READ_MEMORY(instruction.argument);
+    PC = (PC + 2) % ADDRESS_SPACE_SIZE;
+    NEXT_AFTER_READ();
+
+executeAND:
+    A &= READ_MEMORY(instruction.argument);
+    PC = (PC + 2) % ADDRESS_SPACE_SIZE;
+    NEXT_AFTER_READ();
+
+executeST:
+    if (instruction.argument == IO_INTERFACE_ADDRESS) putOutputChar(state->terminalOutput, A);
+    else setMemory(state, instruction.argument, A);
+    PC = (PC + 2) % ADDRESS_SPACE_SIZE;
+    NEXT();
+
+executeJMP:
+    PROFILE_JUMP(true);
+    if (PC == instruction.argument) {
+        state->haltReason = HaltReasonInfiniteLoop;
+        goto end;
+    }
+    PC = instruction.argument;
+    NEXT();
+
+executeJMN:
+    PROFILE_JUMP(A & 0x80);
+    PC = (A & 0x80) ? instruction.argument : (PC + 2) % ADDRESS_SPACE_SIZE;
+    NEXT();
+
+executeJMZ:
+    PROFILE_JUMP(A == 0);
+    PC = A == 0 ? instruction.argument : (PC + 2) % ADDRESS_SPACE_SIZE;
+    NEXT();
+
+end:
+    if (profile != NULL) ++profile->runEnds[PC];
+    state->PC = PC;
+    state->A = A;
+    state->cycleCount = initialCycleCount + cycles;
+
+    return cycles;
+}
@@ -0,0 +1,10 @@
+#ifndef threaded_engine
+#define threaded_engine
+
+#include "../machine-state/machine-state.h"
+
+// Has the same semantics as repeatedly calling step(), but dispatches every opcode with its own indirect jump. The context is
+// NULL, or a struct Profile to fill.
+unsigned long runThreaded(struct MachineState* state, void* context, unsigned long cycleBudget);
+
+#endif
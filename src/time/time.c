@@ -4,5 +4,21 @@
 unsigned long getTimeMs() {
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
-    return now.tv_nsec / 1000000 * now.tv_sec * 1000;
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+unsigned long long getTimeNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+void sleepUntilNs(unsigned long long deadlineNs) {
+    unsigned long long now = getTimeNs();
+
+    if (deadlineNs <= now) return;
+
+    unsigned long long duration = deadlineNs - now;
+    struct timespec request = { duration / 1000000000ull, duration % 1000000000ull };
+    nanosleep(&request, NULL);
 }
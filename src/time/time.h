@@ -3,4 +3,8 @@
 
 unsigned long getTimeMs();
 
+unsigned long long getTimeNs();
+
+void sleepUntilNs(unsigned long long deadlineNs);
+
 #endif
@@ -0,0 +1,438 @@
+#include "trace.h"
+#include "../machine-state/machine-state.h"
+#include "../terminal-output/terminal-output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h> // POSIX
+#include <signal.h>
+
+#define TRACE_MAGIC "W13TRACE"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_LENGTH (8 + 4 + 2 + 1 + 1 + 8 + ADDRESS_SPACE_SIZE)
+#define TRACE_CHUNK_HEADER_LENGTH 8
+
+// ^C ends the simulation normally instead of killing it, so that the trace is complete
+static volatile sig_atomic_t isInterrupted = false;
+
+static void interrupt(int _) {
+    isInterrupted = true;
+}
+
+static void putNumber(unsigned char* bytes, unsigned long long value, int length) {
+    for (int i = 0; i < length; ++i) bytes[i] = value >> (8 * i);
+}
+
+static unsigned long long getNumber(unsigned char* bytes, int length) {
+    unsigned long long value = 0;
+    for (int i = 0; i < length; ++i) value |= (unsigned long long) bytes[i] << (8 * i);
+    return value;
+}
+
+// Instructions overlapping memory-mapped registers are fetched by reading them, so they're only known after they execute
+static unsigned short getFetchedInstruction(unsigned short PC, unsigned char low, unsigned char high, unsigned char* registerReads) {
+    int readIndex = 0;
+    if (PC >= TIME_INTERFACE_ADDRESS) low = registerReads[readIndex++];
+    if ((PC + 1) % ADDRESS_SPACE_SIZE >= TIME_INTERFACE_ADDRESS) high = registerReads[readIndex];
+    return low | high << 8;
+}
+
+static void* writeChunks(void* context) {
+    struct TraceWriter* writer = context;
+
+    while (true) {
+        pthread_mutex_lock(&writer->lock);
+        while (writer->filledCount == 0 && !writer->isClosing) pthread_cond_wait(&writer->chunkFilled, &writer->lock);
+        bool isDone = writer->filledCount == 0;
+        pthread_mutex_unlock(&writer->lock);
+
+        if (isDone) break;
+
+        struct TraceChunk* chunk = &writer->chunks[writer->writeIndex];
+        unsigned char header[TRACE_CHUNK_HEADER_LENGTH];
+        putNumber(header, chunk->length, 4);
+        putNumber(header + 4, chunk->instructionCount, 4);
+
+        if (fwrite(header, 1, TRACE_CHUNK_HEADER_LENGTH, writer->file) != TRACE_CHUNK_HEADER_LENGTH
+            || fwrite(chunk->data, 1, chunk->length, writer->file) != chunk->length) {
+            writer->hasFailed = true;
+        }
+
+        writer->writeIndex = (writer->writeIndex + 1) % TRACE_CHUNK_COUNT;
+
+        pthread_mutex_lock(&writer->lock);
+        --writer->filledCount;
+        pthread_cond_signal(&writer->chunkWritten);
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    return NULL;
+}
+
+// Hands the chunk over to the writer thread, waiting if it's behind by all the other chunks
+static void submitChunk(struct TraceWriter* writer) {
+    pthread_mutex_lock(&writer->lock);
+    ++writer->filledCount;
+    pthread_cond_signal(&writer->chunkFilled);
+    while (writer->filledCount == TRACE_CHUNK_COUNT) pthread_cond_wait(&writer->chunkWritten, &writer->lock);
+    pthread_mutex_unlock(&writer->lock);
+
+    writer->fillIndex = (writer->fillIndex + 1) % TRACE_CHUNK_COUNT;
+    writer->chunks[writer->fillIndex].length = 0;
+    writer->chunks[writer->fillIndex].instructionCount = 0;
+}
+
+static inline unsigned char* reserveRecord(struct TraceWriter* writer) {
+    struct TraceChunk* chunk = &writer->chunks[writer->fillIndex];
+
+    if (chunk->length > TRACE_CHUNK_SIZE - TRACE_MAX_RECORD_LENGTH) {
+        submitChunk(writer);
+        chunk = &writer->chunks[writer->fillIndex];
+    }
+
+    return chunk->data + chunk->length;
+}
+
+struct TraceWriter* createTraceWriter(const char* traceFilePath, struct MachineState* state) {
+    FILE* file = fopen(traceFilePath, "wb");
+
+    if (file == NULL) {
+        printf("Error: could not write file \"%s\".\n", traceFilePath);
+        return NULL;
+    }
+
+    unsigned char header[TRACE_HEADER_LENGTH] = { 0 };
+    memcpy(header, TRACE_MAGIC, 8);
+    putNumber(header + 8, TRACE_VERSION, 4);
+    putNumber(header + 12, state->PC, 2);
+    header[14] = state->A;
+    putNumber(header + 16, state->cycleCount, 8);
+    memcpy(header + 24, state->memory, ADDRESS_SPACE_SIZE);
+    fwrite(header, 1, TRACE_HEADER_LENGTH, file);
+
+    struct TraceWriter* writer = calloc(1, sizeof(struct TraceWriter));
+    writer->file = file;
+    writer->chunks = malloc(TRACE_CHUNK_COUNT * sizeof(struct TraceChunk));
+    writer->chunks[0].length = 0;
+    writer->chunks[0].instructionCount = 0;
+    writer->PC = state->PC - 2;
+    writer->A = state->A;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->chunkFilled, NULL);
+    pthread_cond_init(&writer->chunkWritten, NULL);
+    pthread_create(&writer->thread, NULL, writeChunks, writer);
+
+    isInterrupted = false;
+    signal(SIGINT, interrupt);
+
+    return writer;
+}
+
+bool destroyTraceWriter(struct TraceWriter* writer, enum HaltReason haltReason) {
+    signal(SIGINT, SIG_DFL);
+
+    unsigned char* record = reserveRecord(writer);
+    record[0] = TRACE_HALT;
+    record[1] = haltReason;
+    writer->chunks[writer->fillIndex].length += 2;
+
+    pthread_mutex_lock(&writer->lock);
+    ++writer->filledCount;
+    writer->isClosing = true;
+    pthread_cond_signal(&writer->chunkFilled);
+    pthread_mutex_unlock(&writer->lock);
+
+    pthread_join(writer->thread, NULL);
+
+    bool success = !writer->hasFailed && fclose(writer->file) == 0;
+    if (!success) printf("Error: could not write the whole trace.\n");
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->chunkFilled);
+    pthread_cond_destroy(&writer->chunkWritten);
+    free(writer->chunks);
+    free(writer);
+
+    return success;
+}
+
+void traceRegisterRead(struct TraceWriter* writer, unsigned short address, unsigned char value, bool hasInputEnded) {
+    unsigned char* record = reserveRecord(writer);
+
+    if (hasInputEnded) {
+        record[0] = TRACE_END_OF_INPUT;
+        writer->chunks[writer->fillIndex].length += 1;
+    } else {
+        record[0] = TRACE_REGISTER_READ + address - TIME_INTERFACE_ADDRESS;
+        record[1] = value;
+        writer->chunks[writer->fillIndex].length += 2;
+    }
+
+    if (writer->registerReadCount < 3) writer->registerReads[writer->registerReadCount++] = value;
+}
+
+// The machine registers, the cursor, and the last recorded PC and A are kept in locals, because stores of record bytes may
+// alias them. Register reads append records themselves, so everything is synchronized around instructions that may read
+// registers, which are executed by step().
+unsigned long runTraced(struct MachineState* state, void* context, unsigned long cycleBudget) {
+    struct TraceWriter* writer = context;
+    struct TraceChunk* chunk = &writer->chunks[writer->fillIndex];
+    unsigned char* record = chunk->data + chunk->length;
+    unsigned int instructionCount = chunk->instructionCount;
+    unsigned short nextRecordedPC = (writer->PC + 2) % ADDRESS_SPACE_SIZE;
+    unsigned char recordedA = writer->A;
+    unsigned short PC = state->PC;
+    unsigned char A = state->A;
+    unsigned long long initialCycleCount = state->cycleCount;
+    unsigned long cycles = 0;
+
+    do {
+        unsigned short executedPC = PC;
+        struct DecodedInstruction decoded = PC < TIME_INTERFACE_ADDRESS - 1 ? getDecodedInstruction(state, PC) : (struct DecodedInstruction) { 0 };
+        unsigned short instruction = decoded.opcode << 13 | decoded.argument;
+        unsigned short argument = decoded.argument;
+
+        if (decoded.clockCycles != 0 && (decoded.opcode > 3 || argument < TIME_INTERFACE_ADDRESS)) {
+            switch (decoded.opcode) {
+                case 0: A = state->memory[argument]; PC += 2; break; // LD
+                case 1: A = ~state->memory[argument]; PC += 2; break; // NOT
+                case 2: A += state->memory[argument]; PC += 2; break; // ADD
+                case 3: A &= state->memory[argument]; PC += 2; break; // AND
+                case 4: // ST
+                    if (argument == IO_INTERFACE_ADDRESS) putOutputChar(state->terminalOutput, A);
+                    else setMemory(state, argument, A);
+                    PC += 2;
+                    break;
+                case 5: // JMP
+                    if (PC == argument) state->haltReason = HaltReasonInfiniteLoop;
+                    else PC = argument;
+                    break;
+                case 6: PC = (A & 0x80) ? argument : PC + 2; break; // JMN
+                case 7: PC = A == 0 ? argument : PC + 2; break; // JMZ
+            }
+
+            PC %= ADDRESS_SPACE_SIZE;
+            cycles += decoded.clockCycles;
+        } else {
+            chunk->length = record - chunk->data;
+            chunk->instructionCount = instructionCount;
+            state->PC = PC;
+            state->A = A;
+            state->cycleCount = initialCycleCount + cycles;
+
+            unsigned char low = state->memory[PC];
+            unsigned char high = state->memory[(PC + 1) % ADDRESS_SPACE_SIZE];
+            writer->registerReadCount = 0;
+            cycles += step(state);
+            if (decoded.clockCycles == 0) instruction = getFetchedInstruction(PC, low, high, writer->registerReads);
+
+            PC = state->PC;
+            A = state->A;
+            chunk = &writer->chunks[writer->fillIndex];
+            record = chunk->data + chunk->length;
+            instructionCount = chunk->instructionCount;
+        }
+
+        if (record > chunk->data + TRACE_CHUNK_SIZE - TRACE_MAX_RECORD_LENGTH) {
+            chunk->length = record - chunk->data;
+            chunk->instructionCount = instructionCount;
+            submitChunk(writer);
+            chunk = &writer->chunks[writer->fillIndex];
+            record = chunk->data;
+            instructionCount = 0;
+        }
+
+        // Optional fields are written unconditionally and skipped if they don't follow, which avoids mispredicted branches
+        unsigned char opcode = instruction >> 13;
+        bool isPCFollowing = executedPC != nextRecordedPC;
+        bool isAFollowing = A != recordedA;
+        unsigned char* header = record;
+
+        *header = opcode | isPCFollowing * TRACE_PC_FOLLOWS | isAFollowing * TRACE_A_FOLLOWS;
+        putNumber(record + 1, executedPC, 2);
+        record += 1 + 2 * isPCFollowing;
+        *record = A;
+        record += isAFollowing;
+        putNumber(record, instruction & 0x1fff, 2);
+        record += 2 * (opcode == 4);
+
+        recordedA = A;
+        nextRecordedPC = (executedPC + 2) % ADDRESS_SPACE_SIZE;
+        ++instructionCount;
+    } while (cycles < cycleBudget && state->haltReason == HaltReasonNone);
+
+    chunk->length = record - chunk->data;
+    chunk->instructionCount = instructionCount;
+    writer->PC = nextRecordedPC - 2;
+    writer->A = recordedA;
+    state->PC = PC;
+    state->A = A;
+    state->cycleCount = initialCycleCount + cycles;
+
+    if (isInterrupted && state->haltReason == HaltReasonNone) state->haltReason = HaltReasonInterrupted;
+
+    return cycles;
+}
+
+// Returns -1 at the end of the trace
+static int readRecordByte(struct TraceReader* reader) {
+    while (reader->position == reader->chunk->length) {
+        unsigned char header[TRACE_CHUNK_HEADER_LENGTH];
+        if (fread(header, 1, TRACE_CHUNK_HEADER_LENGTH, reader->file) != TRACE_CHUNK_HEADER_LENGTH) return -1;
+
+        reader->chunk->length = getNumber(header, 4);
+        reader->chunk->instructionCount = getNumber(header + 4, 4);
+        reader->position = 0;
+
+        if (reader->chunk->length > TRACE_CHUNK_SIZE
+            || fread(reader->chunk->data, 1, reader->chunk->length, reader->file) != reader->chunk->length) {
+            reader->chunk->length = 0;
+            return -1;
+        }
+    }
+
+    return reader->chunk->data[reader->position++];
+}
+
+static int peekRecordByte(struct TraceReader* reader) {
+    int byte = readRecordByte(reader);
+    if (byte >= 0) --reader->position;
+    return byte;
+}
+
+static unsigned short readRecordNumber(struct TraceReader* reader) {
+    int low = readRecordByte(reader);
+    int high = readRecordByte(reader);
+    return (low < 0 ? 0 : low) | (high < 0 ? 0 : high) << 8;
+}
+
+static void reportDivergence(struct TraceReader* reader, struct MachineState* state, unsigned short PC) {
+    if (reader->hasDiverged) return;
+
+    flushOutput(state->terminalOutput);
+    printf("Error: the execution diverged from the trace \"%s\" at instruction %llu, PC = ", reader->filePath, reader->instructionCount);
+    printLocation(reader->symbols, PC, stdout);
+    printf(".\n");
+    reader->hasDiverged = true;
+}
+
+unsigned char replayRegisterRead(struct TraceReader* reader, struct MachineState* state, unsigned short address) {
+    if (reader->hasDiverged) return 0;
+
+    int record = readRecordByte(reader);
+    unsigned char value = 0;
+
+    if (record == TRACE_END_OF_INPUT && address == IO_INTERFACE_ADDRESS) {
+        state->haltReason = HaltReasonEndOfInput;
+    } else if (record == TRACE_REGISTER_READ + address - TIME_INTERFACE_ADDRESS) {
+        value = readRecordByte(reader);
+    } else {
+        reportDivergence(reader, state, state->PC);
+    }
+
+    if (reader->registerReadCount < 3) reader->registerReads[reader->registerReadCount++] = value;
+
+    return value;
+}
+
+static void checkInstruction(struct TraceReader* reader, struct MachineState* state, unsigned short PC, unsigned short instruction) {
+    if (reader->hasDiverged) return;
+
+    int header = readRecordByte(reader);
+    if (header < 0 || header & TRACE_REGISTER_READ || (header & 7) != instruction >> 13) {
+        reportDivergence(reader, state, PC);
+        return;
+    }
+
+    unsigned short recordedPC = header & TRACE_PC_FOLLOWS ? readRecordNumber(reader) : (reader->PC + 2) % ADDRESS_SPACE_SIZE;
+    unsigned char recordedA = header & TRACE_A_FOLLOWS ? readRecordByte(reader) : reader->A;
+    bool isStoreRecorded = (header & 7) != 4 || readRecordNumber(reader) == (instruction & 0x1fff);
+
+    if (recordedPC != PC || recordedA != state->A || !isStoreRecorded) reportDivergence(reader, state, PC);
+
+    reader->PC = PC;
+    reader->A = state->A;
+    ++reader->instructionCount;
+}
+
+bool replayTrace(struct MachineState* state, const char* traceFilePath, struct Symbols* symbols) {
+    FILE* file = fopen(traceFilePath, "rb");
+
+    if (file == NULL) {
+        printf("Error: could not read file \"%s\".\n", traceFilePath);
+        return false;
+    }
+
+    unsigned char header[TRACE_HEADER_LENGTH];
+
+    if (fread(header, 1, TRACE_HEADER_LENGTH, file) != TRACE_HEADER_LENGTH || memcmp(header, TRACE_MAGIC, 8) != 0) {
+        printf("Error: \"%s\" is not a trace file.\n", traceFilePath);
+        fclose(file);
+        return false;
+    }
+
+    if (getNumber(header + 8, 4) != TRACE_VERSION) {
+        printf("Error: the version of the trace file \"%s\" is not supported.\n", traceFilePath);
+        fclose(file);
+        return false;
+    }
+
+    state->PC = getNumber(header + 12, 2);
+    state->A = header[14];
+    state->cycleCount = getNumber(header + 16, 8);
+    memcpy(state->memory, header + 24, ADDRESS_SPACE_SIZE);
+    invalidateDecodedInstructions(state);
+
+    struct TraceReader* reader = calloc(1, sizeof(struct TraceReader));
+    reader->file = file;
+    reader->filePath = traceFilePath;
+    reader->symbols = symbols;
+    reader->chunk = malloc(sizeof(struct TraceChunk));
+    reader->chunk->length = 0;
+    reader->PC = state->PC - 2;
+    reader->A = state->A;
+    state->traceReader = reader;
+
+    while (state->haltReason == HaltReasonNone) {
+        int record = peekRecordByte(reader);
+
+        if (record < 0) {
+            // The recording simulator didn't exit normally
+            flushOutput(state->terminalOutput);
+            printf("Warning: the trace ended without a halt reason after %llu instructions.\n", reader->instructionCount);
+            break;
+        } else if (record == TRACE_HALT) {
+            readRecordByte(reader);
+            int haltReason = readRecordByte(reader);
+            state->haltReason = haltReason > 0 ? haltReason : HaltReasonInfiniteLoop;
+            break;
+        }
+
+        unsigned short PC = state->PC;
+
+        if (PC < TIME_INTERFACE_ADDRESS - 1) {
+            struct DecodedInstruction decoded = getDecodedInstruction(state, PC);
+            step(state);
+            checkInstruction(reader, state, PC, decoded.opcode << 13 | decoded.argument);
+        } else {
+            unsigned char low = state->memory[PC];
+            unsigned char high = state->memory[(PC + 1) % ADDRESS_SPACE_SIZE];
+            reader->registerReadCount = 0;
+            step(state);
+            checkInstruction(reader, state, PC, getFetchedInstruction(PC, low, high, reader->registerReads));
+        }
+
+        if (reader->hasDiverged) break;
+    }
+
+    bool hasDiverged = reader->hasDiverged;
+    flushOutput(state->terminalOutput);
+
+    state->traceReader = NULL;
+    fclose(file);
+    free(reader->chunk);
+    free(reader);
+
+    return !hasDiverged;
+}
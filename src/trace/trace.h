@@ -0,0 +1,88 @@
+#ifndef trace_h
+#define trace_h
+
+#include "../machine-state/machine-state.h"
+#include "../symbols/symbols.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h> // POSIX
+
+#define TRACE_CHUNK_SIZE 0x10000
+#define TRACE_CHUNK_COUNT 8 // chunks filled by the simulation thread while the writer thread writes the others
+
+// A trace file starts with the magic bytes, the version, the initial PC, A, and cycle count, and the whole memory. Chunks of
+// records follow, each starting with its length in bytes and the number of instructions it records. Records don't span
+// chunks, and numbers are little-endian.
+//
+// Instruction records start with the opcode in the lowest 3 bits. Unless its flag is set, the PC is the previous one plus 2
+// and A doesn't change. A stored address follows the ST instruction. Register reads made by an instruction precede its
+// record. The halt record is the last one.
+#define TRACE_PC_FOLLOWS 0x08
+#define TRACE_A_FOLLOWS 0x10
+#define TRACE_REGISTER_READ 0x80 // plus the offset of the register from TIME_INTERFACE_ADDRESS, the value follows
+#define TRACE_END_OF_INPUT 0x88 // the I/O register read 0 after the whole input was read
+#define TRACE_HALT 0x90 // the halt reason follows
+
+#define TRACE_MAX_RECORD_LENGTH 6
+
+struct TraceChunk {
+    unsigned int length;
+    unsigned int instructionCount;
+    unsigned char data[TRACE_CHUNK_SIZE];
+};
+
+struct TraceWriter {
+    FILE* file;
+    struct TraceChunk* chunks; // ring of TRACE_CHUNK_COUNT chunks
+    int fillIndex; // chunk filled by the simulation thread
+    int writeIndex; // oldest chunk waiting for the writer thread
+    int filledCount; // chunks waiting for the writer thread, guarded by lock
+    bool isClosing; // guarded by lock
+    bool hasFailed; // only written by the writer thread
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t chunkFilled;
+    pthread_cond_t chunkWritten;
+
+    unsigned short PC; // of the last recorded instruction
+    unsigned char A;
+    unsigned char registerReads[3]; // values read by the current instruction, which may fetch it from registers
+    int registerReadCount;
+};
+
+struct TraceReader {
+    FILE* file;
+    const char* filePath;
+    struct Symbols* symbols; // locate divergences
+    struct TraceChunk* chunk;
+    unsigned int position;
+    unsigned long long instructionCount; // replayed so far
+    unsigned short PC;
+    unsigned char A;
+    unsigned char registerReads[3];
+    int registerReadCount;
+    bool hasDiverged; // the divergence was reported, and the replay ends after the current instruction
+};
+
+// Writes the header with the state, and starts the writer thread. Prints an error and returns NULL if the file can't be written.
+struct TraceWriter* createTraceWriter(const char* traceFilePath, struct MachineState* state);
+
+// Records the halt reason, writes the remaining records, and frees the writer. Prints an error and returns false if the
+// trace couldn't be written.
+bool destroyTraceWriter(struct TraceWriter* writer, enum HaltReason haltReason);
+
+// Has the same semantics as repeatedly calling step(), and records every instruction with the trace writer passed as the context
+unsigned long runTraced(struct MachineState* state, void* writer, unsigned long cycleBudget);
+
+// Called when the machine reads a memory-mapped register while being traced
+void traceRegisterRead(struct TraceWriter* writer, unsigned short address, unsigned char value, bool hasInputEnded);
+
+// Called instead of reading a memory-mapped register while replaying a trace. Returns 0 if the read isn't the recorded one.
+unsigned char replayRegisterRead(struct TraceReader* reader, struct MachineState* state, unsigned short address);
+
+// Loads the initial state from the trace and runs the program with the recorded register values as fast as possible,
+// checking every instruction against the trace. Prints an error with the location in the program and returns false if
+// the trace can't be read or the execution diverges from it.
+bool replayTrace(struct MachineState* state, const char* traceFilePath, struct Symbols* symbols);
+
+#endif